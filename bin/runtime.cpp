@@ -0,0 +1,406 @@
+#include "runtime.hpp"
+int steps = 0;
+std::string name;
+std::string input_name;
+std::string output_name;
+std::vector<char> characters;
+int width = 0;
+int height = 0;
+int depth = 0;
+size_t capacity = 0;
+uint64_t seed = 0;
+void wrapHalo(std::vector<uint8_t> &grid, int r) {
+    int stride = width + 2 * r;
+    size_t plane = (size_t) stride * (height + 2 * r);
+    for(int z = r; z < depth + r; z++) {
+        for(int y = r; y < height + r; y++) {
+            uint8_t *row = &grid[z * plane + y * stride];
+            for(int i = 0; i < r; i++) {
+                row[i] = row[width + i];
+                row[width + r + i] = row[r + i];
+            }
+        }
+        for(int i = 0; i < r; i++) {
+            std::copy_n(&grid[z * plane + (height + i) * stride], stride, &grid[z * plane + i * stride]);
+            std::copy_n(&grid[z * plane + (r + i) * stride], stride, &grid[z * plane + (height + r + i) * stride]);
+        }
+    }
+    for(int i = 0; i < r; i++) {
+        std::copy_n(&grid[(depth + i) * plane], plane, &grid[i * plane]);
+        std::copy_n(&grid[(r + i) * plane], plane, &grid[(depth + r + i) * plane]);
+    }
+}
+bool encodePadded(const std::vector<char> &states, std::vector<uint8_t> &grid, int r) {
+    uint8_t indices[256];
+    memset(indices, 0xFF, sizeof(indices));
+    for(int i = 0; i < (int) states.size(); i++) {
+        indices[(unsigned char) states[i]] = i;
+    }
+    int stride = width + 2 * r;
+    size_t plane = (size_t) stride * (height + 2 * r);
+    for(int z = 0; z < depth; z++) {
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                uint8_t state = indices[(unsigned char) characters[((size_t) z * height + y) * width + x]];
+                if(state == 0xFF) {
+                    return false;
+                }
+                grid[(z + r) * plane + (y + r) * stride + x + r] = state;
+            }
+        }
+    }
+    return true;
+}
+void decodePadded(const std::vector<char> &states, const std::vector<uint8_t> &grid, int r) {
+    int stride = width + 2 * r;
+    size_t plane = (size_t) stride * (height + 2 * r);
+    for(int z = 0; z < depth; z++) {
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                characters[((size_t) z * height + y) * width + x] = states[grid[(z + r) * plane + (y + r) * stride + x + r]];
+            }
+        }
+    }
+}
+std::string checkpoint_name;
+int checkpoint_every = 0;
+std::string resume_name;
+std::string frame_pattern;
+int frame_every = 0;
+int region_x = 0;
+int region_y = 0;
+int region_width = 0;
+int region_height = 0;
+int downsample = 1;
+bool density = false;
+std::string frameName(int64_t generation) {
+    size_t end = frame_pattern.find_last_of('#') + 1;
+    size_t begin = frame_pattern.find_last_not_of('#', end - 1) + 1;
+    std::string number = std::to_string(generation);
+    if(number.size() < end - begin) {
+        number = std::string(end - begin - number.size(), '0') + number;
+    }
+    return frame_pattern.substr(0, begin) + number + frame_pattern.substr(end);
+}
+void putBigEndian(std::string &bytes, uint32_t n) {
+    for(int shift = 24; shift >= 0; shift -= 8) {
+        bytes += (char) (n >> shift);
+    }
+}
+uint32_t pngCrc(const std::string &bytes, size_t begin) {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> table;
+        for(uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }();
+    uint32_t c = 0xFFFFFFFFu;
+    for(size_t i = begin; i < bytes.size(); i++) {
+        c = table[(c ^ (unsigned char) bytes[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+std::string encodePng(const std::vector<uint8_t> &rgb, int w, int h) {
+    // Each scanline is led by its filter, 0 for none.
+    std::string raw;
+    raw.reserve((size_t) (w * 3 + 1) * h);
+    for(int y = 0; y < h; y++) {
+        raw += '\0';
+        raw.append((const char *) &rgb[(size_t) y * w * 3], (size_t) w * 3);
+    }
+    std::string data = "\x78\x01";
+    for(size_t i = 0; i < raw.size(); i += 65535) {
+        size_t n = std::min<size_t>(65535, raw.size() - i);
+        data += (char) (i + n == raw.size());
+        data += (char) n;
+        data += (char) (n >> 8);
+        data += (char) ~n;
+        data += (char) (~n >> 8);
+        data.append(raw, i, n);
+    }
+    // Adler-32, reduced only as often as its sums could overflow.
+    uint32_t a = 1, b = 0;
+    for(size_t i = 0; i < raw.size(); i += 5552) {
+        for(size_t j = i; j < std::min(raw.size(), i + 5552); j++) {
+            a += (unsigned char) raw[j];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    putBigEndian(data, b << 16 | a);
+    std::string png = "\x89PNG\r\n\x1A\n";
+    auto chunk = [&](const char *type, const std::string &body) {
+        putBigEndian(png, body.size());
+        size_t begin = png.size();
+        png += type;
+        png += body;
+        putBigEndian(png, pngCrc(png, begin));
+    };
+    std::string header;
+    putBigEndian(header, w);
+    putBigEndian(header, h);
+    header += std::string("\x08\x02\x00\x00\x00", 5);
+    chunk("IHDR", header);
+    chunk("IDAT", data);
+    chunk("IEND", "");
+    return png;
+}
+bool writeFrame(int64_t generation, const std::vector<uint8_t> &view, int columns, int rows,
+        const std::vector<char> &states, const std::vector<uint32_t> &colours) {
+    std::string name = frameName(generation);
+    bool ppm = name.size() >= 4 && name.compare(name.size() - 4, 4, ".ppm") == 0;
+    bool png = name.size() >= 4 && name.compare(name.size() - 4, 4, ".png") == 0;
+    std::string bytes;
+    if(ppm || png) {
+        // Each pixel is copied as four bytes of the palette, the fourth overwritten by the next pixel,
+        // so the lookup is a load and a store whatever the colour.
+        uint8_t palette[256][4] = {};
+        for(int i = 0; i < 256; i++) {
+            uint32_t colour = density ? (std::min(i, 100) * 255 / 100) * 0x010101u : i < (int) colours.size() ? colours[i] : 0;
+            palette[i][0] = colour >> 16;
+            palette[i][1] = colour >> 8;
+            palette[i][2] = colour;
+        }
+        std::vector<uint8_t> rgb(view.size() * 3 + 1);
+        for(size_t i = 0; i < view.size(); i++) {
+            memcpy(&rgb[i * 3], palette[view[i]], 4);
+        }
+        rgb.pop_back();
+        // Layers of a 3D grid are stacked down the image.
+        if(ppm) {
+            bytes = "P6\n" + std::to_string(columns) + " " + std::to_string(rows * depth) + "\n255\n";
+            bytes.append((const char *) rgb.data(), rgb.size());
+        } else {
+            bytes = encodePng(rgb, columns, rows * depth);
+        }
+    } else {
+        bytes.reserve(view.size() + (size_t) rows * depth + depth);
+        for(size_t i = 0; i < view.size(); i++) {
+            if(i > 0 && i % ((size_t) columns * rows) == 0) {
+                bytes += '\n';
+            }
+            bytes += density ? (char) ('0' + std::min(9, view[i] / 10)) : states[view[i]];
+            if((i + 1) % columns == 0) {
+                bytes += '\n';
+            }
+        }
+    }
+    FILE *file = fopen(name.c_str(), "wb");
+    if(file == NULL) {
+        return false;
+    }
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && written;
+}
+bool map_output = false;
+bool writeOutput() {
+    size_t row = width + 1;
+    size_t layer = (size_t) height * row + 1;
+    size_t length = characters.empty() ? 0 : depth * layer - 1;
+    if(map_output && length > 0) {
+        // Rows are copied straight into the mapped file, by as many threads as there are cores.
+        int fd = ::open(output_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0 || ftruncate(fd, length) != 0) {
+            if(fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+        char *text = (char *) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(text == MAP_FAILED) {
+            return false;
+        }
+        parallel(depth * height, [&](int begin, int end) {
+            for(int r = begin; r < end; r++) {
+                char *out = text + (r / height) * layer + (r % height) * row;
+                memcpy(out, &characters[(size_t) r * width], width);
+                out[width] = '\n';
+                if(r % height == height - 1 && r < depth * height - 1) {
+                    out[width + 1] = '\n';
+                }
+            }
+        });
+        return munmap(text, length) == 0;
+    }
+    FILE *output = fopen(output_name.c_str(), "w");
+    if(output == NULL) {
+        return false;
+    }
+    std::vector<char> text(row);
+    text[width] = '\n';
+    bool written = true;
+    for(int r = 0; r < depth * height && written; r++) {
+        if(r > 0 && r % height == 0) {
+            written = putc('\n', output) != EOF;
+        }
+        memcpy(text.data(), &characters[(size_t) r * width], width);
+        written = written && fwrite(text.data(), 1, row, output) == row;
+    }
+    return fclose(output) == 0 && written;
+}
+const char* readDense(FILE *input, bool store) {
+    int pos = 0;
+    int rows = 0;
+    int c;
+    do {
+        c = getc(input);
+        if(c == '\r') {
+            continue;
+        }
+        if(c != '\n' && c != EOF) {
+            if(store) {
+                characters.push_back(c);
+            }
+            pos++;
+            continue;
+        }
+        bool blank = pos == 0;
+        if(!blank) {
+            if(width == 0) {
+                width = pos;
+            } else if(pos != width) {
+                return "Error: Contradicing dimensions within INPUT file.";
+            }
+            rows++;
+            pos = 0;
+        }
+        if((blank || c == EOF) && rows > 0) {
+            if(depth == 0) {
+                height = rows;
+            } else if(rows != height) {
+                return "Error: Contradicing dimensions within INPUT file.";
+            }
+            depth++;
+            rows = 0;
+        }
+    } while(c != EOF);
+    return "";
+}
+bool isRle(const std::string &file) {
+    return file.size() > 4 && file.compare(file.size() - 4, 4, ".rle") == 0;
+}
+int rleTag(int prefix, int c) {
+    if(c == 'b' || c == '.') {
+        return 0;
+    }
+    if(c == 'o') {
+        return 1;
+    }
+    if(c >= 'A' && c <= 'X') {
+        return (prefix == 0 ? 0 : (prefix - 'p' + 1) * 24) + c - 'A' + 1;
+    }
+    return -1;
+}
+const char* readRle(FILE *input, const std::string &palette) {
+    if(palette == "") {
+        return "Error: Incorrect 2nd operand MODEL must be a name of a model";
+    }
+    int c;
+    // Comments precede the header, which gives the dimensions of the grid.
+    while((c = getc(input)) == '#') {
+        while((c = getc(input)) != '\n' && c != EOF);
+    }
+    ungetc(c, input);
+    if(fscanf(input, " x = %d , y = %d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        return "Error: Missing the header of the RLE INPUT.";
+    }
+    while((c = getc(input)) != '\n' && c != EOF);
+    depth = 1;
+    characters.assign((size_t) width * height, palette[0]);
+    int x = 0, y = 0, count = 0, prefix = 0;
+    while((c = getc(input)) != EOF && c != '!') {
+        if(c >= '0' && c <= '9') {
+            count = count * 10 + c - '0';
+            continue;
+        }
+        if(c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            continue;
+        }
+        if(c >= 'p' && c <= 'y') {
+            prefix = c;
+            continue;
+        }
+        int run = std::max(count, 1);
+        count = 0;
+        if(c == '$') {
+            y += run;
+            x = 0;
+            continue;
+        }
+        int state = rleTag(prefix, c);
+        prefix = 0;
+        if(state < 0 || state >= (int) palette.size()) {
+            return "Error: Unrecognised state within INPUT.";
+        }
+        if(x + run > width || y >= height) {
+            return "Error: The RLE INPUT overflows its dimensions.";
+        }
+        if(state != 0) {
+            memset(&characters[(size_t) y * width + x], palette[state], run);
+        }
+        x += run;
+    }
+    return "";
+}
+bool writeRle(const std::string &palette) {
+    std::string tags[256];
+    for(int i = 0; i < (int) palette.size(); i++) {
+        if(palette.size() <= 2) {
+            tags[(unsigned char) palette[i]] = i == 0 ? "b" : "o";
+        } else if(i == 0) {
+            tags[(unsigned char) palette[i]] = ".";
+        } else {
+            int prefix = (i - 1) / 24;
+            tags[(unsigned char) palette[i]] = (prefix > 0 ? std::string(1, 'p' + prefix - 1) : "") + std::string(1, 'A' + (i - 1) % 24);
+        }
+    }
+    FILE *output = fopen(output_name.c_str(), "w");
+    if(output == NULL) {
+        return false;
+    }
+    fprintf(output, "x = %d, y = %d\n", width, height);
+    // Lines are kept within 70 characters, as is conventional.
+    std::string line;
+    auto emit = [&](int run, const std::string &tag) {
+        std::string item = (run > 1 ? std::to_string(run) : "") + tag;
+        if(line.size() + item.size() > 70) {
+            fprintf(output, "%s\n", line.c_str());
+            line.clear();
+        }
+        line += item;
+    };
+    int ends = 0;
+    for(int y = 0; y < height; y++) {
+        const char *row = &characters[(size_t) y * width];
+        int end = width;
+        while(end > 0 && row[end - 1] == palette[0]) {
+            end--;
+        }
+        ends += y > 0;
+        if(end == 0) {
+            continue;
+        }
+        if(ends > 0) {
+            emit(ends, "$");
+            ends = 0;
+        }
+        for(int x = 0; x < end;) {
+            int run = 1;
+            while(x + run < end && row[x + run] == row[x]) {
+                run++;
+            }
+            emit(run, tags[(unsigned char) row[x]]);
+            x += run;
+        }
+    }
+    emit(1, "!");
+    fprintf(output, "%s\n", line.c_str());
+    return fclose(output) == 0;
+}
@@ -0,0 +1,298 @@
+#pragma once
+#define EMERGENT_RUNTIME 4
+#include <iostream>
+#include <deque>
+#include <string.h>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <stdint.h>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+extern int steps;
+extern std::string name;
+extern std::string input_name;
+extern std::string output_name;
+extern std::vector<char> characters;
+extern int width;
+extern int height;
+extern int depth;
+extern size_t capacity;
+inline int wrap(int i, int length) {
+    return ((i % length) + length) % length;
+}
+// Counts the offsets in list for which f holds, list being evaluated once.
+template<typename List, typename F>
+int countIf(const List &list, F f) {
+    return std::count_if(list.begin(), list.end(), f);
+}
+inline int coordinate1d(int x) {
+ return wrap(x, width);
+}
+extern uint64_t seed;
+inline uint64_t mix(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+}
+// Draws numbers uniformly from [0, 1) for the cell (x, y, z) in generation t. Each draw is a hash of the
+// seed, generation, cell, draw and offset, so runs repeat exactly whatever the threads, tiles or shards.
+struct Dice {
+    int64_t t, x, y, z;
+    double operator()(int draw, int dx = 0, int dy = 0, int dz = 0) const {
+        uint64_t h = mix(mix(mix(mix(seed + 0x9E3779B97F4A7C15ull) ^ t) ^ x) ^ y);
+        h = mix(h ^ z);
+        h = mix(h ^ ((uint64_t) (uint16_t) draw | (uint64_t) (uint16_t) dx << 16 |
+            (uint64_t) (uint16_t) dy << 32 | (uint64_t) (uint16_t) dz << 48));
+        return (h >> 11) * 0x1.0p-53;
+    }
+};
+template<typename F>
+std::thread spawn(F f) {
+    return std::thread(f);
+}
+// Runs body(begin, end) over slabs of [0, length), a thread per slab.
+template<typename F>
+void parallel(int length, F body) {
+    int threads = std::min<int>(std::max(1u, std::thread::hardware_concurrency()), length);
+    std::vector<std::thread> pool;
+    for(int i = 0; i < threads; i++) {
+        int begin = length * i / threads;
+        int end = length * (i + 1) / threads;
+        pool.push_back(spawn([=]() {
+            body(begin, end);
+        }));
+    }
+    for(auto &thread : pool) {
+        thread.join();
+    }
+}
+const int TILE3D = 16;
+// Copies the cells opposite each face into the halo, so the padded grid wraps around.
+void wrapHalo(std::vector<uint8_t> &grid, int r);
+bool encodePadded(const std::vector<char> &states, std::vector<uint8_t> &grid, int r);
+void decodePadded(const std::vector<char> &states, const std::vector<uint8_t> &grid, int r);
+// Checkpoints hold the generation reached, the seed of the dice and a byte per cell,
+// in row-major order whatever the layout.
+struct CheckpointHeader {
+    char magic[8];
+    int32_t width, height, depth, states;
+    int64_t generation;
+    uint64_t seed;
+};
+extern std::string checkpoint_name;
+extern int checkpoint_every;
+extern std::string resume_name;
+// Writes checkpoints on a background thread, so generations carry on while they reach the disk.
+class Checkpointer {
+    std::vector<uint8_t> cells;
+    std::thread writer;
+    bool failed = false;
+    void write(int64_t generation, int states) {
+        CheckpointHeader header = {{'E', 'M', 'G', 'C', 'K', 'P', 'T', '2'}, width, height, depth, states, generation, seed};
+        // Written beside the checkpoint then renamed over it, so a crash never leaves half a checkpoint.
+        std::string temporary = checkpoint_name + ".tmp";
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if(file == NULL) {
+            failed = true;
+            return;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(cells.data(), 1, cells.size(), file) == cells.size() &&
+            fflush(file) == 0 && fsync(fileno(file)) == 0;
+        written = fclose(file) == 0 && written;
+        if(!written || rename(temporary.c_str(), checkpoint_name.c_str()) != 0) {
+            failed = true;
+        }
+    }
+  public:
+    ~Checkpointer() {
+        finish();
+    }
+    // Copies every cell(x, y, z) and writes them once the previous checkpoint is written.
+    template<typename F>
+    bool save(int64_t generation, int states, F cell) {
+        if(!finish()) {
+            return false;
+        }
+        cells.resize((size_t) width * height * depth);
+        size_t i = 0;
+        for(int z = 0; z < depth; z++) {
+            for(int y = 0; y < height; y++) {
+                for(int x = 0; x < width; x++) {
+                    cells[i++] = cell(x, y, z);
+                }
+            }
+        }
+        writer = spawn([=]() {
+            write(generation, states);
+        });
+        return true;
+    }
+    // Waits for the checkpoint being written, returning whether every checkpoint was written.
+    bool finish() {
+        if(writer.joinable()) {
+            writer.join();
+        }
+        return !failed;
+    }
+};
+// Maps the checkpoint to resume from, checking it was taken of a grid like this one.
+class Resumed {
+    void *map = MAP_FAILED;
+    size_t length = 0;
+  public:
+    const char *error = "";
+    int64_t generation = 0;
+    const uint8_t *cells = nullptr;
+    Resumed(int states) {
+        int fd = ::open(resume_name.c_str(), O_RDONLY);
+        struct stat info;
+        if(fd < 0 || fstat(fd, &info) != 0) {
+            error = "Error: Unable to open the checkpoint to resume.";
+            if(fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+        length = info.st_size;
+        size_t expected = sizeof(CheckpointHeader) + (size_t) width * height * depth;
+        if(length == expected) {
+            map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if(map == MAP_FAILED) {
+            error = "Error: The checkpoint does not match INPUT.";
+            return;
+        }
+        const CheckpointHeader *header = (const CheckpointHeader *) map;
+        if(memcmp(header->magic, "EMGCKPT2", 8) != 0 || header->width != width || header->height != height ||
+                header->depth != depth || header->states != states || header->generation > steps) {
+            error = "Error: The checkpoint does not match INPUT.";
+            return;
+        }
+        generation = header->generation;
+        // Resumed runs carry on drawing from the dice they were checkpointed with.
+        seed = header->seed;
+        cells = (const uint8_t *) map + sizeof(CheckpointHeader);
+        for(size_t i = 0; i < length - sizeof(CheckpointHeader); i++) {
+            if(cells[i] >= states) {
+                error = "Error: Unrecognised state within the checkpoint.";
+                return;
+            }
+        }
+    }
+    ~Resumed() {
+        if(map != MAP_FAILED) {
+            munmap(map, length);
+        }
+    }
+    uint8_t operator()(int x, int y, int z) const {
+        return cells[((size_t) z * height + y) * width + x];
+    }
+};
+// Frames are written every frame_every generations, to frame_pattern with its #s replaced by the generation,
+// as binary PPM if it ends in .ppm, as PNG if it ends in .png, otherwise as text.
+extern std::string frame_pattern;
+extern int frame_every;
+// Frames hold the region_width by region_height cells from (region_x, region_y), or all of them if 0,
+// each block of downsample by downsample cells drawn as its most common state, or its density if set.
+extern int region_x;
+extern int region_y;
+extern int region_width;
+extern int region_height;
+extern int downsample;
+extern bool density;
+// Names the frame of a generation, zero padding it to the length of the run of #s.
+std::string frameName(int64_t generation);
+void putBigEndian(std::string &bytes, uint32_t n);
+// CRC-32 of bytes from begin, as PNG chunks end with.
+uint32_t pngCrc(const std::string &bytes, size_t begin);
+// Encodes w by h RGB pixels as PNG, in deflate blocks left uncompressed so that no library is needed.
+std::string encodePng(const std::vector<uint8_t> &rgb, int w, int h);
+// Writes a frame of the states in view, or their densities in percent, columns by rows a layer.
+bool writeFrame(int64_t generation, const std::vector<uint8_t> &view, int columns, int rows,
+        const std::vector<char> &states, const std::vector<uint32_t> &colours);
+// Draws frames as the grid is simulated, writing them on a background thread as checkpoints are.
+class Framer {
+    std::vector<uint8_t> view;
+    std::thread writer;
+    bool failed = false;
+  public:
+    ~Framer() {
+        finish();
+    }
+    // Draws the region of the grid through cell(x, y, z), reading only the cells within it,
+    // and writes it once the previous frame is written.
+    template<typename F>
+    bool save(int64_t generation, const std::vector<char> &states, const std::vector<uint32_t> &colours,
+            uint8_t background, F cell) {
+        if(!finish()) {
+            return false;
+        }
+        int w = region_width > 0 ? region_width : width;
+        int h = region_height > 0 ? region_height : height;
+        int columns = (w + downsample - 1) / downsample;
+        int rows = (h + downsample - 1) / downsample;
+        view.resize((size_t) columns * rows * depth);
+        std::vector<int> counts(states.size());
+        size_t i = 0;
+        for(int z = 0; z < depth; z++) {
+            for(int row = 0; row < rows; row++) {
+                for(int column = 0; column < columns; column++) {
+                    std::fill(counts.begin(), counts.end(), 0);
+                    int y_end = std::min(h, (row + 1) * downsample);
+                    int x_end = std::min(w, (column + 1) * downsample);
+                    for(int y = row * downsample; y < y_end; y++) {
+                        for(int x = column * downsample; x < x_end; x++) {
+                            counts[cell(wrap(region_x + x, width), wrap(region_y + y, height), z)]++;
+                        }
+                    }
+                    if(density) {
+                        // The percentage of the block outside the background state.
+                        int cells = (y_end - row * downsample) * (x_end - column * downsample);
+                        view[i++] = (cells - counts[background]) * 100 / cells;
+                    } else {
+                        view[i++] = std::max_element(counts.begin(), counts.end()) - counts.begin();
+                    }
+                }
+            }
+        }
+        writer = spawn([=]() {
+            failed = !writeFrame(generation, view, columns, rows, states, colours);
+        });
+        return true;
+    }
+    // Waits for the frame being written, returning whether every frame was written.
+    bool finish() {
+        if(writer.joinable()) {
+            writer.join();
+        }
+        return !failed;
+    }
+};
+extern bool map_output;
+// Writes OUTPUT a row at a time, each layer of a 3D grid followed by a blank line but the last.
+bool writeOutput();
+// Reads a grid of characters, layers of a 3D grid separated by blank lines, keeping them if store is set.
+const char* readDense(FILE *input, bool store);
+// Files ending in .rle hold run-length encoded patterns, as in Life RLE.
+bool isRle(const std::string &file);
+// RLE tags name the default state b or ., and the other states o or A, B, ... up to pX,
+// in the order of the palette, which holds the characters of the default state then the others.
+int rleTag(int prefix, int c);
+const char* readRle(FILE *input, const std::string &palette);
+// Writes OUTPUT as RLE, a run at a time, leaving out the default state at the ends of rows.
+bool writeRle(const std::string &palette);
@@ -76,6 +76,14 @@ std::string ast::Program::ast() const {
   return text + "\n";
 };
 
+std::vector<std::string> ast::Program::modelIds() const {
+  std::vector<std::string> ids;
+  for(auto & model : models) {
+    ids.push_back(model->model_id);
+  }
+  return ids;
+};
+
 std::string ast::Model::ast() const {
   std::string text = "<model> " + model_id + " ~ " + neighbourhood_id + ":";
   indent_level++;
@@ -88,6 +96,9 @@ std::string ast::Model::ast() const {
 std::string ast::State::ast() const {
   std::string char_string(1, character);
   std::string text = "<state> " + id + " " + char_string;
+  if(colour) {
+    text += " " + colour->ast();
+  }
   if(is_default) {
     return text + " ~ default"; 
   }
@@ -170,6 +181,14 @@ std::string ast::Decimal::ast() const {
   return "<decimal> " + std::to_string(value);
 };
 
+std::string ast::Colour::ast() const {
+  return "<colour> " + std::to_string(red) + " " + std::to_string(green) + " " + std::to_string(blue);
+};
+
+std::string ast::Random::ast() const {
+  return "<random>";
+};
+
 std::string ast::Identifier::ast() const {
   return "<identifier> " + id;
 };
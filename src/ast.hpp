@@ -1,7 +1,9 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
+#include <set>
 #include "stdint.h"
 #include "lexer.hpp"
 
@@ -46,8 +48,74 @@ namespace ast {
     return text;
   };
 
+  class Node;
+  class Neighbourhood;
+
+  // Options which change the layout or engine of the generated code.
+  struct Options {
+    // Stores 2D grids in Z-order (Morton order), instead of row-major.
+    bool morton = false;
+    // Advances tiles several generations at a time, whilst they're in cache.
+    bool blocking = false;
+    // Lets simulators split the grid into bands, simulated by separate processes.
+    bool sharding = false;
+    // Lets simulators skip ahead once the grid settles into a cycle.
+    bool cycles = false;
+    // Lets simulators tally the cells in each state every generation, within the sweep.
+    bool statistics = false;
+    // Lets simulators stream grids larger than memory through files.
+    bool streaming = false;
+    // Lets simulators grow 2D grids over an unbounded plane of the default state.
+    bool unbounded = false;
+    // Lets simulators run a manifest of jobs concurrently.
+    bool batch = false;
+    // Lets simulators advance the layers of INPUT as independent instances, together in vector lanes.
+    bool ensemble = false;
+    // Dimensions of the grids simulators are specialised for, or 0 if none.
+    int width = 0;
+    int height = 0;
+    // Name the header and units of each model are named after when split, or "" for a single file.
+    std::string split;
+    // Directory of the prebuilt libemergent.a simulators link, or "" to emit the runtime within them.
+    std::string library;
+  };
+  extern Options options;
+  // Header and source of the runtime shared by every simulator, by the suffix of their names.
+  std::map<std::string, std::string> runtimeLibrary();
+
+  // Values of the cells a predicate reads, so it can be evaluated whilst compiling.
+  struct Assignment {
+    // Value of each state, in order of declaration.
+    std::map<std::string, int> states;
+    // Neighbour names, mapped to their coordinates.
+    std::map<std::string, std::shared_ptr<Node>> names;
+    // THIS or a coordinate, mapped to the variable holding its value.
+    std::map<std::string, int> cells;
+    // The node which first read each variable's cell.
+    std::vector<std::shared_ptr<Node>> reads;
+    std::vector<int> values;
+    int dimensions;
+    // Registers unseen cells as new variables.
+    bool collecting = false;
+  };
+
+  // Reduced ordered decision diagram, from the values of the cells read to the next state.
+  struct Diagram {
+    // Terminal vertices have no variable, and their state as the only child.
+    struct Vertex {
+      int variable;
+      std::vector<int> children;
+    };
+    // Generates the read of each variable's cell.
+    std::vector<std::shared_ptr<Node>> reads;
+    // Amount of values each variable takes, one for each state.
+    int values;
+    std::vector<Vertex> vertices;
+    int root;
+  };
+
   // Abstract/General class for any node in the AST.
-  class Node {
+  class Node : public std::enable_shared_from_this<Node> {
     private:
       // Token at the time of parsing.
       const TOKEN current_token;
@@ -59,6 +127,10 @@ namespace ast {
       virtual std::string ast() const;
       // Generates code given the AST.
       virtual std::string codegen() = 0;
+      // Returns the states THIS could be in whenever the expression holds.
+      virtual std::set<std::string> guards();
+      // Evaluates the expression given the cells' values, returning false if it can't be.
+      virtual bool evaluate(Assignment &assignment, int &value);
       // Outputs the semantic error to the terminal.
       void SemanticError(std::string title, std::string error_message);
   };
@@ -117,6 +189,8 @@ namespace ast {
           right(std::move(right)) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      virtual std::set<std::string> guards();
+      virtual bool evaluate(Assignment &assignment, int &value);
   };
 
   // Represents the integer literal.
@@ -142,6 +216,7 @@ namespace ast {
       virtual std::string ast() const;
       virtual std::string codegen();
       virtual std::string codegen_restricted();
+      virtual bool evaluate(Assignment &assignment, int &value);
   };
 
   // Represents the decimal literal.
@@ -156,6 +231,28 @@ namespace ast {
       virtual std::string codegen();
   };
 
+  // The colour a state is drawn in, within image frames.
+  class Colour : public Node {
+    public:
+      const int red, green, blue;
+      Colour(
+        int red,
+        int green,
+        int blue
+      ) : red(red),
+          green(green),
+          blue(blue) {};
+      virtual std::string ast() const;
+      virtual std::string codegen();
+  };
+
+  // Represents a number drawn uniformly from [0, 1), afresh for each cell and generation.
+  class Random : public Node {
+    public:
+      virtual std::string ast() const;
+      virtual std::string codegen();
+  };
+
   // Represents the ID token.
   class Identifier : public Node {
     public:
@@ -165,6 +262,7 @@ namespace ast {
       ) : id(id) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      virtual bool evaluate(Assignment &assignment, int &value);
   };
 
   // Represents the negation unary operation.
@@ -177,6 +275,7 @@ namespace ast {
       ) : value(std::move(value)) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      virtual bool evaluate(Assignment &assignment, int &value);
   };
 
   // Represents the negative unary operation.
@@ -218,22 +317,33 @@ namespace ast {
       const std::string id;
       const char character;
       const bool is_default = false;
+      // The colour declared for the state, if any.
+      const std::shared_ptr<Colour> colour;
       State(
         bool is_default,
         const std::string &id,
-        const char character
-      ) : is_default(is_default),
-          id(id),
-          character(character) {};
+        const char character,
+        std::shared_ptr<Colour> colour
+      ) : id(id),
+          character(character),
+          is_default(is_default),
+          colour(std::move(colour)) {};
       State(
         const std::string &id,
         const char character,
+        std::shared_ptr<Colour> colour,
         std::shared_ptr<Node> predicate
-      ) : id(id),
+      ) : predicate(std::move(predicate)),
+          id(id),
           character(character),
-          predicate(std::move(predicate)) {};
+          colour(std::move(colour)) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      // Generates the predicate alone, as an expression which holds whenever the state is next.
+      std::string condition();
+      virtual std::set<std::string> guards();
+      // Evaluates whether the state is next, returning false if it can't be.
+      bool evaluate(Assignment &assignment, bool &holds);
   };
 
   // Defines CA formal definition.
@@ -250,8 +360,14 @@ namespace ast {
       ) : model_id(model_id),
           neighbourhood_id(neighbourhood_id),
           states(std::move(states)) {};
+      // Replaces the predicates, if possible, when set.
+      std::shared_ptr<Diagram> diagram;
       virtual std::string ast() const;
       virtual std::string codegen();
+      // Builds the decision diagram, given the model's neighbourhood.
+      void decide(std::shared_ptr<Neighbourhood> neighbourhood);
+      // The characters of the states, the default state first, as RLE orders them.
+      std::string palette() const;
   };
 
   // A neighbour of the central cell.
@@ -267,6 +383,8 @@ namespace ast {
           coordinate(std::move(coordinate)) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      // Registers the neighbour's name for evaluation.
+      void decide(Assignment &assignment);
   };
 
   // All neighbours stored here, to be used in multiple models.
@@ -285,6 +403,8 @@ namespace ast {
           neighbours(std::move(neighbours)) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      // Registers the neighbours' names for evaluation.
+      void decide(Assignment &assignment);
   };
 
   // Represents the program itself.
@@ -300,6 +420,12 @@ namespace ast {
           neighbourhoods(neighbourhoods) {};
       virtual std::string ast() const;
       virtual std::string codegen();
+      // Builds decision diagrams for every model that only compares cells to states.
+      void decide();
+      // Names of the models, in order of declaration.
+      std::vector<std::string> modelIds() const;
+      // Code of the files besides the dispatcher when split, by the suffix of their names.
+      std::map<std::string, std::string> units;
   };
 
 
@@ -1,15 +1,96 @@
 #include "ast.hpp"
 #include "lexer.hpp"
 #include <map>
+#include <set>
+#include <iterator>
 #include <algorithm>
 
 using namespace ast;
 
+Options ast::options;
 std::map<std::string, std::shared_ptr<ast::Node>> globals;
 std::map<std::string, std::map<std::string, std::shared_ptr<Coordinate>>> neighbour_ids;
 std::shared_ptr<Neighbourhood> current_neighbourhood = nullptr;
 std::map<std::string, std::shared_ptr<ast::State>> local_states;
+// Dense index of each state, in order of declaration.
+std::map<std::string, int> state_indices;
 std::vector<std::string> variables;
+// Number of random draws in the current model, each of which is given its own stream.
+int draws = 0;
+// Whether predicates are generated branch-free, evaluating every operand, for the lane kernel of ensembles.
+bool masked = false;
+// Largest offset of any coordinate, along any axis.
+int radius = 0;
+std::map<std::string, int> neighbourhood_radii;
+// Version of the prebuilt runtime, bumped whenever sharedRuntime() changes what it declares.
+const int RUNTIME_VERSION = 4;
+
+// Returns the identifiers of every state in the current model.
+std::set<std::string> allStates() {
+    std::set<std::string> all;
+    for(auto & state : local_states) {
+        // Lookups of unrecognised names leave empty entries behind.
+        if(state.second) {
+            all.insert(state.first);
+        }
+    }
+    return all;
+}
+
+std::set<std::string> ast::Node::guards() {
+    return allStates();
+}
+
+// Returns the state THIS is compared against, or "" if it isn't such a comparison.
+std::string guardedState(std::shared_ptr<Node> left, std::shared_ptr<Node> right) {
+    auto l = std::dynamic_pointer_cast<Identifier>(left);
+    auto r = std::dynamic_pointer_cast<Identifier>(right);
+    if(!l || !r) {
+        return "";
+    }
+    if(r->id == "this") {
+        std::swap(l, r);
+    }
+    if(l->id != "this" || !allStates().count(r->id)) {
+        return "";
+    }
+    // Neighbour names shadow state names.
+    if(neighbour_ids[current_neighbourhood->id][r->id]) {
+        return "";
+    }
+    return r->id;
+}
+
+std::set<std::string> ast::Binary::guards() {
+    std::set<std::string> result;
+    if(operation == EQ || operation == NE) {
+        std::string state = guardedState(left, right);
+        if(state == "") {
+            return Node::guards();
+        }
+        if(operation == EQ) {
+            result.insert(state);
+        } else {
+            result = Node::guards();
+            result.erase(state);
+        }
+        return result;
+    }
+
+    std::set<std::string> l = left->guards();
+    std::set<std::string> r = right->guards();
+    switch(operation) {
+        case AND:
+            std::set_intersection(l.begin(), l.end(), r.begin(), r.end(), std::inserter(result, result.begin()));
+            return result;
+        case OR:
+        case XOR:
+            std::set_union(l.begin(), l.end(), r.begin(), r.end(), std::inserter(result, result.begin()));
+            return result;
+        default: break;
+    }
+    return Node::guards();
+}
 
 std::string ast::Binary::codegen() {
     std::string l = left->codegen();
@@ -21,6 +102,17 @@ std::string ast::Binary::codegen() {
         return "";
     }
 
+    // Operands are all evaluated, and divisors of 0 replaced by 1, as no short-circuit guards them.
+    if(masked) {
+        switch(operation) {
+            case AND: return "((bool) " + l + " & (bool) " + r + ")";
+            case OR: return "((bool) " + l + " | (bool) " + r + ")";
+            case XOR: return "((bool) " + l + " ^ (bool) " + r + ")";
+            case DIV: return "(" + l + " / (" + r + " + (" + r + " == 0)))";
+            case MOD: return "(" + l + " % (" + r + " + (" + r + " == 0)))";
+            default: break;
+        }
+    }
     switch(operation) {
         case AND: return "(" + l + " && " + r + ")";
         case OR: return "(" + l + " || " + r + ")";
@@ -51,10 +143,7 @@ std::string ast::Coordinate::codegen() {
     if(code == "") {
         return "";
     }
-    if(current_neighbourhood->dimensions == 1) {
-        return "coordinate1d(x +" + code + ")";
-    }
-    return "coordinate2d(add_point(" + code + ", x, y))";
+    return "cells(" + vector->codegen() + ")";
 }
 
 std::string ast::Coordinate::codegen_restricted() {
@@ -62,17 +151,42 @@ std::string ast::Coordinate::codegen_restricted() {
         SemanticError("Coordinate", "Dimension don't match neighbourhood.");
         return "";
     }
+    for(auto item : vector->items) {
+        radius = std::max(radius, std::abs(std::stoi(item->codegen())));
+    }
     if(current_neighbourhood->dimensions == 1) {
         return vector->codegen();
     }
     return "{" + vector->codegen() + "}";
 }
 std::string ast::Decimal::codegen() {
-    return std::to_string(value);
+    // Printed in full, as small probabilities would otherwise round to 0.
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+std::string ast::Colour::codegen() {
+    char text[16];
+    snprintf(text, sizeof(text), "0x%06X", red << 16 | green << 8 | blue);
+    return text;
+}
+std::string ast::Random::codegen() {
+    std::string draw = std::to_string(draws++);
+    // Draws within a set are made afresh for each of its coordinates.
+    if(variables.empty()) {
+        return "dice(" + draw + ")";
+    }
+    std::string id = variables.back();
+    if(current_neighbourhood->dimensions == 1) {
+        return "dice(" + draw + ", " + id + ")";
+    } else if(current_neighbourhood->dimensions == 3) {
+        return "dice(" + draw + ", " + id + "[0], " + id + "[1], " + id + "[2])";
+    }
+    return "dice(" + draw + ", " + id + ".first, " + id + ".second)";
 }
 std::string ast::Identifier::codegen() {
     if(id == "this") {
-        return "prev[current]";
+        return "cells.centre()";
     }
 
     auto coordinate = neighbour_ids[current_neighbourhood->id][id];
@@ -81,17 +195,18 @@ std::string ast::Identifier::codegen() {
         if(!state) {
             if(std::count(variables.begin(), variables.end(), id)) {
                 if(current_neighbourhood->dimensions == 1) {
-                    return "prev[coordinate1d(x + " + id + ")]";
+                    return "cells(" + id + ")";
+                } else if(current_neighbourhood->dimensions == 3) {
+                    return "cells(" + id + "[0], " + id + "[1], " + id + "[2])";
                 }
-                return "prev[coordinate2d(add_point(" + id + ", x, y))]";
+                return "cells(" + id + ".first, " + id + ".second)";
             }
 
             SemanticError("Idenitifier", "Unrecognised name");
             return "";
         }
         // Is a reference to a state
-        std::string char_string(1, state->character);
-        return "\'" + char_string + "\'";
+        return std::to_string(state_indices[id]);
     }
     return coordinate->codegen();
 }
@@ -105,10 +220,10 @@ std::string ast::Cardinality::codegen() {
     variables.push_back(variable);
     
     std::string type = "int";
-    std::string d = "1d";
     if(current_neighbourhood->dimensions == 2) {
         type = "std::pair<int, int>";
-        d = "2d";
+    } else if(current_neighbourhood->dimensions == 3) {
+        type = "std::array<int, 3>";
     }
 
     std::string list;
@@ -116,11 +231,16 @@ std::string ast::Cardinality::codegen() {
         //Any
         list = current_neighbourhood->id;
     } else { 
-        list = coords->codegen();
-        if(list == "") {
-            return "";
+        bool flag = false;
+        for(auto coord : coords->items) {
+            std::string code = coord->codegen_restricted();
+            if(code == "") {
+                return "";
+            }
+            list = list + (flag ? ", " : "") + code;
+            flag = true;
         }
-        list = "vec" +  d + "("+  list + ")";
+        list = "std::array<" + type + ", " + std::to_string(coords->items.size()) + ">{{" + list + "}}";
     }
 
     std::string condition = predicate->codegen();
@@ -129,23 +249,23 @@ std::string ast::Cardinality::codegen() {
     }
     variables.erase(std::remove(variables.begin(), variables.end(), variable), variables.end());
     return 
-        "std::count_if(" + list + ".begin(), " + list + ".end(), [=](" + type + " " + variable + ") { return" + condition + ";})"
+        std::string(masked ? "countUnrolled(" : "countIf(") + list + ", [&](" + type + " " + variable + ") { return" + condition + ";})"
         ;
 }
 std::string ast::State::codegen() {
-    std::string char_string(1, character);
+    std::string index = std::to_string(state_indices[id]);
     
     if(is_default) {
         return
             "{\n"
-            "              next[current] = \'" + char_string + "\';\n"
-            "           }\n";
+            "        return " + index + ";\n"
+            "    }\n";
     }
 
     if(!predicate) {
         return 
             "if(false) {\n"
-            "           } else ";
+            "    } else ";
     }
     std::string code = predicate->codegen();
     if(code == "") {
@@ -154,8 +274,176 @@ std::string ast::State::codegen() {
 
     return
         "if(" + code + ") {\n"
-        "               next[current] = \'" + char_string + "\';\n"
-        "           } else ";
+        "        return " + index + ";\n"
+        "    } else ";
+}
+
+std::string ast::State::condition() {
+    if(!predicate) {
+        return "false";
+    }
+    return predicate->codegen();
+}
+
+std::set<std::string> ast::State::guards() {
+    if(!predicate) {
+        return std::set<std::string>();
+    }
+    return predicate->guards();
+}
+
+// Generates the vertex and every vertex reachable from it, as labelled blocks.
+std::string vertexCode(Diagram &diagram, int index, std::set<int> &visited) {
+    if(!visited.insert(index).second) {
+        return "";
+    }
+    auto & vertex = diagram.vertices[index];
+    // The root is entered first, so is never jumped to.
+    std::string label;
+    if(index != diagram.root) {
+        label = "    dd_" + std::to_string(index) + ":\n";
+    }
+    if(vertex.variable < 0) {
+        return label +
+            "    return " + std::to_string(vertex.children[0]) + ";\n";
+    }
+
+    std::string code = label +
+        "    switch(" + diagram.reads[vertex.variable]->codegen() + ") {\n";
+    // The final state is the default case, as cells only hold states.
+    int last = vertex.children.size() - 1;
+    for(int value = 0; value < last; value++) {
+        code = code +
+            "        case " + std::to_string(value) + ": goto dd_" + std::to_string(vertex.children[value]) + ";\n";
+    }
+    code = code +
+        "        default: goto dd_" + std::to_string(vertex.children[last]) + ";\n"
+        "    }\n";
+    for(int child : vertex.children) {
+        code = code + vertexCode(diagram, child, visited);
+    }
+    return code;
+}
+
+// Whether the current model skips cycles, which stochastic grids may repeat without being in.
+static bool skipping() {
+    return options.cycles && draws == 0;
+}
+
+// Saves a checkpoint once the generations up to next cross a multiple of checkpoint_every.
+static std::string checkpointCode(const std::string &t, const std::string &next, const std::string &cell) {
+    return
+        "       if(checkpoint_every > 0 && " + next + " / checkpoint_every > " + t + " / checkpoint_every &&\n"
+        "               !checkpointer.save(" + next + ", states.size(), [&](int x, int y, int z) { return " + cell + "; })) {\n"
+        "           return \"Error: Unable to write a checkpoint.\";\n"
+        "       }\n";
+}
+
+// Writes a frame once the generations up to next cross a multiple of frame_every.
+static std::string frameCode(const std::string &t, const std::string &next, const std::string &cell) {
+    return
+        "       if(frame_every > 0 && " + next + " / frame_every > " + t + " / frame_every &&\n"
+        "               !framer.save(" + next + ", states, colours, background, [&](int x, int y, int z) { return " + cell + "; })) {\n"
+        "           return \"Error: Unable to write a frame.\";\n"
+        "       }\n";
+}
+
+// Replaces the cells read from INPUT with those of the checkpoint, resuming from its generation.
+static std::string resumeCode(const std::string &store) {
+    return
+        "   int t = 0;\n"
+        "   if(resume_name != \"\") {\n"
+        "       Resumed resumed(states.size());\n"
+        "       if(*resumed.error) {\n"
+        "           return resumed.error;\n"
+        "       }\n"
+        "       t = resumed.generation;\n"
+        "       for(int z = 0; z < depth; z++) {\n"
+        "           for(int y = 0; y < height; y++) {\n"
+        "               for(int x = 0; x < width; x++) {\n"
+        "                   " + store + ";\n"
+        "               }\n"
+        "           }\n"
+        "       }\n"
+        "   }\n"
+        "   Checkpointer checkpointer;\n"
+        "   Framer framer;\n" +
+        std::string(skipping() ? "   Cycles cycles;\n" : "");
+}
+
+// Skips whole periods once the grid of generation next is known to repeat.
+static std::string cycleCode(const std::string &t, const std::string &next, const std::string &cells) {
+    if(!skipping()) {
+        return "";
+    }
+    // Frames and statistics are written for generations throughout, so none are skipped whilst writing them.
+    std::string writing = options.statistics ? "gathering || frame_every > 0" : "frame_every > 0";
+    return
+        "       if(int period = " + writing + " ? 0 : cycles.observe(" + next + ", hash, " + cells + ")) {\n"
+        "           " + t + " += (steps - " + next + ") / period * period;\n"
+        "       }\n";
+}
+
+// Declares a grid of the given size, which batches keep between jobs rather than reallocating.
+static std::string reuse(const std::string &type, const std::string &id, const std::string &size) {
+    if(!options.batch) {
+        return "   " + type + " " + id + "(" + size + ");\n";
+    }
+    std::string clear = type == "std::vector<uint8_t>" ? ".assign(" + size + ", 0)" : ".reset(" + size + ")";
+    // Bound by reference, as lambdas run on other threads would otherwise see their own copies.
+    return
+        "   static thread_local " + type + " " + id + "_kept(0);\n"
+        "   " + type + " &" + id + " = " + id + "_kept;\n"
+        "   " + id + clear + ";\n";
+}
+
+// Counts a cell in state into tally, whenever condition holds.
+static std::string tallyCode(const std::string &indent, const std::string &condition, const std::string &tally,
+        const std::string &x, const std::string &y, const std::string &z, const std::string &state) {
+    if(!options.statistics) {
+        return "";
+    }
+    return
+        indent + "if(" + condition + ") {\n" +
+        indent + "    " + tally + ".add(" + x + ", " + y + ", " + z + ", " + state + ", background);\n" +
+        indent + "}\n";
+}
+
+// Writes the statistics of generation next, from tally.
+static std::string statsCode(const std::string &next, const std::string &tally) {
+    if(!options.statistics) {
+        return "";
+    }
+    return
+        "       if(gathering && !statistics.write(" + next + ", " + tally + ")) {\n"
+        "           return \"Error: Unable to write STATS.\";\n"
+        "       }\n";
+}
+
+static std::string finishCode() {
+    return
+        "   if(!checkpointer.finish()) {\n"
+        "       return \"Error: Unable to write a checkpoint.\";\n"
+        "   }\n"
+        "   if(!framer.finish()) {\n"
+        "       return \"Error: Unable to write a frame.\";\n"
+        "   }\n" +
+        std::string(options.statistics ?
+        "   if(!statistics.close()) {\n"
+        "       return \"Error: Unable to write STATS.\";\n"
+        "   }\n" : "");
+}
+
+std::string ast::Model::palette() const {
+    std::string palette;
+    for(auto state : states->items) {
+        if(state->is_default) {
+            palette = std::string(1, state->character) + palette;
+        } else {
+            palette = palette + state->character;
+        }
+    }
+    return palette;
 }
 
 std::string ast::Model::codegen() {
@@ -165,39 +453,24 @@ std::string ast::Model::codegen() {
     }
     //Have to cast down from Node, as Models are Global too
     current_neighbourhood = std::static_pointer_cast<Neighbourhood, Node>(globals.find(neighbourhood_id)->second);
-    
-    std::string code = 
-        "const char* " + model_id + "() {\n";
-    std::string ending_brace;
-    if(current_neighbourhood->dimensions == 1) {
-        code = code +
-            "   if(height > 1) {\n"
-            "       return \"Error: Expected 1 Dimension for INPUT.\";\n"
-            "   }\n"
-            "   std::vector<char> next(width);\n"
-            "   for(int t = 0; t < steps; t++) {\n"
-            "       for(int x = 0; x < width; x++) {\n"
-            "           int current = x;\n"
-            "           ";
-    } else {
-        code = code +
-            "   std::vector<char> next(width * height);\n"
-            "   for(int t = 0; t < steps; t++) {\n"
-            "       for(int x = 0; x < width; x++) {\n"
-            "       for(int y = 0; y < height; y++) {\n"
-            "           int current = coordinate2d({x,y});\n"
-            "           ";
-        ending_brace = 
-            "       }\n";
-    }
+    int dimensions = current_neighbourhood->dimensions;
+    int outer_radius = radius;
+    radius = neighbourhood_radii[neighbourhood_id];
 
+    draws = 0;
     std::shared_ptr<State> default_state;
+    std::set<char> characters;
     for(auto state : states->items) {
+        state_indices[state->id] = state_indices.size();
         auto it = local_states.insert({state->id, state});
         if(!it.second) {
             state->SemanticError("State", "Duplicate identifiers conflict.");
             return "";
         }
+        if(!characters.insert(state->character).second) {
+            state->SemanticError("State", "Duplicate characters conflict.");
+            return "";
+        }
 
         if(state->is_default) {
             if(default_state) {
@@ -209,26 +482,504 @@ std::string ast::Model::codegen() {
         }
     }
 
+    if(!default_state) {
+        SemanticError("Model", "Missing a Default State.");
+        return "";
+    }
+    if(states->items.size() > 256) {
+        SemanticError("Model", "More than 256 states.");
+        return "";
+    }
+
+    // Predicates are tested in order, so each is kept alongside the states THIS may be in for it to hold.
+    std::vector<std::pair<std::string, std::set<std::string>>> predicates;
+    bool guarded = false;
+    // Whether a predicate that can hold whilst THIS is in the default state draws random numbers.
+    bool default_draws = false;
+    std::set<std::string> all = allStates();
     for(auto state : states->items) {
         if(!state->is_default) {
+            int before = draws;
             std::string state_string = state->codegen();
             if(state_string == "") {
                 return "";
             }
-            code = code + state_string;
+            std::set<std::string> guards = state->guards();
+            if(guards.size() < all.size()) {
+                guarded = true;
+            }
+            if(draws > before && guards.count(default_state->id)) {
+                default_draws = true;
+            }
+            predicates.push_back({state_string, guards});
         }
     }
-    
-    code = code + default_state->codegen();
+    std::string fallback = default_state->codegen();
 
-    code = code + ending_brace +
-        "       }\n"
-        "       std::copy(next.begin(), next.end(), prev.begin());\n"
+    // The rule returns the next state of a cell, given an accessor for the cells around it and its dice.
+    std::string rule =
+        "template<typename Cells>\n"
+        "uint8_t " + model_id + "_rule(const Cells &cells, const Dice &dice) {\n";
+    if(diagram) {
+        // Each cell is read at most once, on any path through the diagram.
+        std::set<int> visited;
+        rule = rule + vertexCode(*diagram, diagram->root, visited);
+    } else if(!guarded) {
+        rule = rule + "    ";
+        for(auto & predicate : predicates) {
+            rule = rule + predicate.first;
+        }
+        rule = rule + fallback;
+    } else {
+        // Dispatches on THIS, so only predicates that can hold for the current state are tested.
+        rule = rule + "    switch(cells.centre()) {\n";
+        for(auto state : states->items) {
+            rule = rule +
+                "    case " + std::to_string(state_indices[state->id]) + ":\n"
+                "    ";
+            for(auto & predicate : predicates) {
+                if(predicate.second.count(state->id)) {
+                    rule = rule + predicate.first;
+                }
+            }
+            rule = rule + fallback;
+        }
+        rule = rule +
+            "    }\n"
+            "    return " + std::to_string(state_indices[default_state->id]) + ";\n";
+    }
+    rule = rule + "}\n";
+
+    // Ensembles advance LANES instances of a cell at once, through a kernel without branches. It tests every
+    // predicate as a byte mask, all ones where it holds, selecting states last to first so the first to hold is kept.
+    if(options.ensemble && dimensions < 3) {
+        int scalar_draws = draws;
+        draws = 0;
+        masked = true;
+        std::vector<std::pair<std::string, std::string>> masks;
+        for(auto state : states->items) {
+            if(!state->is_default) {
+                std::string condition = state->condition();
+                if(condition == "") {
+                    masked = false;
+                    return "";
+                }
+                masks.push_back({condition, std::to_string(state_indices[state->id])});
+            }
+        }
+        masked = false;
+        draws = scalar_draws;
+        rule = rule +
+            "template<typename Cells>\n"
+            "uint8_t " + model_id + "_lanes(const Cells &cells, const Dice &dice) {\n"
+            "    uint8_t next = " + std::to_string(state_indices[default_state->id]) + ";\n"
+            "    uint8_t mask;\n";
+        for(auto it = masks.rbegin(); it != masks.rend(); it++) {
+            rule = rule +
+                "    mask = -(uint8_t) ((" + it->first + ") != 0);\n"
+                "    next = (next & ~mask) | (" + it->second + " & mask);\n";
+        }
+        rule = rule +
+            "    return next;\n"
+            "}\n";
+    }
+
+    std::string characters_gen;
+    for(auto state : states->items) {
+        std::string char_string(1, state->character);
+        characters_gen = characters_gen + (characters_gen == "" ? "" : ", ") + "\'" + char_string + "\'";
+    }
+
+    // Cells are packed into the fewest bits that can index every state.
+    int bits = 1;
+    while(((size_t) 1 << bits) < states->items.size()) {
+        bits *= 2;
+    }
+    std::string grid = "Grid<" + std::to_string(bits) + ">";
+
+    // Frames and statistics tell the default state from the rest. Statistics name each state in a column
+    // of their own, followed by the bounds of the other states.
+    std::string names;
+    for(auto state : states->items) {
+        names = names + (names == "" ? "" : ",") + state->id;
+    }
+    std::string gather_gen = "   const uint8_t background = " + std::to_string(state_indices[default_state->id]) + ";\n" +
+        std::string(!options.statistics ? "" :
+        "   Statistics statistics;\n"
+        "   if(!statistics.open(\"" + names + "\", " + std::to_string(states->items.size()) + ", " + std::to_string(dimensions) + ")) {\n"
+        "       return \"Error: Unable to open STATS.\";\n"
         "   }\n"
+        "   const bool gathering = statistics.active();\n");
+
+    // Image frames draw states without a declared colour in shades of grey, from black for the default
+    // state to white for the last.
+    std::string palette_order = palette();
+    std::string colours_gen;
+    for(auto state : states->items) {
+        std::string colour = state->colour ? state->colour->codegen() : "";
+        if(!state->colour) {
+            int shade = palette_order.size() > 1 ? palette_order.find(state->character) * 255 / (palette_order.size() - 1) : 0;
+            colour = std::to_string(shade * 0x010101);
+        }
+        colours_gen = colours_gen + (colours_gen == "" ? "" : ", ") + colour;
+    }
+
+    // Cells hold the index of their state, translated from and to characters only for INPUT and OUTPUT.
+    std::string code = rule +
+        "const char* " + model_id + "() {\n"
+        "   const std::vector<char> states = {" + characters_gen + "};\n"
+        "   const std::vector<uint32_t> colours = {" + colours_gen + "};\n";
+    if(options.statistics) {
+        // Only the sweeps within this function gather statistics.
+        std::string others;
+        if(options.ensemble) {
+            others = others + " || ensemble";
+        }
+        if(options.unbounded) {
+            others = others + " || unbounded";
+        }
+        if(options.streaming) {
+            others = others + " || scratch != \"\"";
+        }
+        if(options.sharding) {
+            others = others + " || shards > 1 || launch > 0";
+        }
+        if(others != "") {
+            code = code +
+                "   if(stats_name != \"\" && (" + others.substr(4) + ")) {\n"
+                "       return \"Error: Statistics cannot be gathered from ensembles, or unbounded, streamed or sharded grids.\";\n"
+                "   }\n";
+        }
+    }
+    if(options.ensemble) {
+        std::string conflicts = "checkpoint_every > 0 || resume_name != \"\" || frame_every > 0";
+        if(options.sharding) {
+            conflicts = conflicts + " || shards > 1 || launch > 0";
+        }
+        if(options.streaming) {
+            conflicts = conflicts + " || scratch != \"\"";
+        }
+        if(options.unbounded) {
+            conflicts = conflicts + " || unbounded";
+        }
+        if(dimensions < 3) {
+            std::string reach = std::to_string(std::max(radius, 1));
+            code = code +
+                "   if(ensemble && (" + conflicts + ")) {\n"
+                "       return \"Error: Ensembles cannot be checkpointed, resumed, framed, sharded, streamed or unbounded.\";\n"
+                "   }\n"
+                "   if(ensemble) {\n"
+                "       return runEnsemble(states, " + reach + ", " + (dimensions == 1 ? "0" : reach) + ", [](const Lanes &cells, const Dice &dice) {\n"
+                "           return " + model_id + "_lanes(cells, dice);\n"
+                "       });\n"
+                "   }\n";
+        } else {
+            code = code +
+                "   if(ensemble) {\n"
+                "       return \"Error: Only 1D and 2D models can be run as ensembles.\";\n"
+                "   }\n";
+        }
+    }
+    if(options.unbounded) {
+        std::string conflicts = "checkpoint_every > 0 || resume_name != \"\" || frame_every > 0";
+        if(options.sharding) {
+            conflicts = conflicts + " || shards > 1 || launch > 0";
+        }
+        if(options.streaming) {
+            conflicts = conflicts + " || scratch != \"\"";
+        }
+        if(dimensions == 2 && default_draws) {
+            // A draw could take any cell of the plane out of the default state, so no chunk could be left absent.
+            code = code +
+                "   if(unbounded) {\n"
+                "       return \"Error: Unbounded grids need the default state to stay amid the default state, without random draws.\";\n"
+                "   }\n";
+        } else if(dimensions == 2) {
+            code = code +
+                "   if(unbounded && (" + conflicts + ")) {\n"
+                "       return \"Error: Unbounded grids cannot be checkpointed, resumed, framed, sharded or streamed.\";\n"
+                "   }\n"
+                "   if(unbounded && depth == 1) {\n"
+                "       return runUnbounded(states, " + std::to_string(state_indices[default_state->id]) + ", " + std::to_string(std::max(radius, 1)) + ", [](const Local &cells, const Dice &dice) {\n"
+                "           return " + model_id + "_rule(cells, dice);\n"
+                "       });\n"
+                "   }\n";
+        } else {
+            code = code +
+                "   if(unbounded) {\n"
+                "       return \"Error: Only 2D models can be unbounded.\";\n"
+                "   }\n";
+        }
+    }
+    if(options.streaming && options.sharding) {
+        code = code +
+            "   if(scratch != \"\" && (shards > 1 || launch > 0)) {\n"
+            "       return \"Error: Streamed grids cannot be sharded.\";\n"
+            "   }\n";
+    }
+    if(options.streaming) {
+        if(dimensions == 2) {
+            code = code +
+                "   if(scratch != \"\" && (checkpoint_every > 0 || resume_name != \"\" || frame_every > 0 || isRle(input_name) || isRle(output_name))) {\n"
+                "       return \"Error: Streamed grids cannot be checkpointed, resumed, framed or run-length encoded.\";\n"
+                "   }\n"
+                "   if(scratch != \"\" && depth == 1) {\n"
+                "       return runStreamed(states, " + std::to_string(std::max(radius, 1)) + ", [](const Local &cells, const Dice &dice) {\n"
+                "           return " + model_id + "_rule(cells, dice);\n"
+                "       });\n"
+                "   }\n";
+        } else {
+            code = code +
+                "   if(scratch != \"\") {\n"
+                "       return \"Error: Only 2D models can be streamed.\";\n"
+                "   }\n";
+        }
+    }
+    if(options.sharding) {
+        if(dimensions == 2) {
+            code = code +
+                "   if(shards > 1 && (checkpoint_every > 0 || resume_name != \"\" || frame_every > 0 || isRle(input_name) || isRle(output_name))) {\n"
+                "       return \"Error: Shards cannot be checkpointed, resumed, framed or run-length encoded.\";\n"
+                "   }\n"
+                "   if(shards > 1) {\n"
+                "       return runShard(states, " + std::to_string(std::max(radius, 1)) + ", [](const Local &cells, const Dice &dice) {\n"
+                "           return " + model_id + "_rule(cells, dice);\n"
+                "       });\n"
+                "   }\n";
+        } else {
+            code = code +
+                "   if(shards > 1) {\n"
+                "       return \"Error: Only 2D models can be sharded.\";\n"
+                "   }\n";
+        }
+    }
+    if(dimensions == 1) {
+        code = code +
+            "   if(height > 1 || depth > 1) {\n"
+            "       return \"Error: Expected 1 Dimension for INPUT.\";\n"
+            "   }\n";
+    } else if(dimensions == 2) {
+        code = code +
+            "   if(depth > 1) {\n"
+            "       return \"Error: Expected 2 Dimensions for INPUT.\";\n"
+            "   }\n";
+    } else {
+        // Cells are kept a byte each, within a halo as deep as the radius, so threads never share a byte.
+        std::string reach = std::to_string(std::max(radius, 1));
+        code = code +
+            "   const int r = " + reach + ";\n"
+            "   if(width < r || height < r || depth < r) {\n"
+            "       return \"Error: INPUT is narrower than the radius of the neighbourhood.\";\n"
+            "   }\n"
+            "   int stride = width + 2 * r;\n"
+            "   int64_t plane = (int64_t) stride * (height + 2 * r);\n"
+            + reuse("std::vector<uint8_t>", "prev", "plane * (depth + 2 * r)") +
+            reuse("std::vector<uint8_t>", "next", "prev.size()") +
+            "   if(!encodePadded(states, prev, r)) {\n"
+            "       return \"Error: Unrecognised state within INPUT.\";\n"
+            "   }\n" +
+            resumeCode("prev[(z + r) * plane + (y + r) * stride + x + r] = resumed(x, y, z)") +
+            gather_gen +
+            "   wrapHalo(prev, r);\n"
+            "   for(; t < steps; t++) {\n" +
+            std::string(skipping() ? "       std::atomic<uint64_t> hash(0);\n" : "") +
+            std::string(options.statistics ?
+            "       Tally tally;\n"
+            "       std::mutex tally_lock;\n" : "") +
+            "       // Each thread sweeps a slab of layers, a tile of rows at a time.\n"
+            "       parallel(depth, [&](int z_begin, int z_end) {\n" +
+            std::string(skipping() ? "           uint64_t sum = 0;\n" : "") +
+            std::string(options.statistics ? "           Tally local;\n" : "") +
+            "           for(int ty = 0; ty < height; ty += TILE3D) {\n"
+            "           for(int z = z_begin; z < z_end; z++) {\n"
+            "           for(int y = ty; y < std::min(ty + TILE3D, height); y++) {\n"
+            "               int64_t row = (z + r) * plane + (y + r) * stride + r;\n"
+            "               for(int x = 0; x < width; x++) {\n"
+            "                   int64_t current = row + x;\n"
+            "                   next[current] = " + model_id + "_rule(Local{prev.data(), stride, plane, current}, Dice{t, x, y, z});\n" +
+            std::string(skipping() ? "                   sum += cellHash(current, next[current]);\n" : "") +
+            tallyCode("                   ", "gathering", "local", "x", "y", "z", "next[current]") +
+            "               }\n"
+            "           }\n"
+            "           }\n"
+            "           }\n" +
+            std::string(skipping() ? "           hash += sum;\n" : "") +
+            std::string(options.statistics ?
+            "           if(gathering) {\n"
+            "               std::lock_guard<std::mutex> guard(tally_lock);\n"
+            "               tally.merge(local);\n"
+            "           }\n" : "") +
+            "       });\n"
+            "       std::swap(next, prev);\n"
+            "       wrapHalo(prev, r);\n" +
+            statsCode("(t + 1)", "tally") +
+            checkpointCode("t", "(t + 1)", "prev[(z + r) * plane + (y + r) * stride + x + r]") +
+            frameCode("t", "(t + 1)", "prev[(z + r) * plane + (y + r) * stride + x + r]") +
+            cycleCode("t", "(t + 1)", "prev") +
+            "   }\n" +
+            finishCode() +
+            "   decodePadded(states, prev, r);\n"
+            "   return \"\";\n"
+            "}\n";
+        local_states.clear();
+        state_indices.clear();
+        current_neighbourhood = nullptr;
+        radius = std::max(outer_radius, radius);
+        return code;
+    }
+    code = code +
+        reuse(grid, "prev", "capacity") +
+        "   if(!encode(states, prev)) {\n"
+        "       return \"Error: Unrecognised state within INPUT.\";\n"
+        "   }\n" +
+        reuse(grid, "next", "capacity") +
+        resumeCode("prev.set(coordinate2d({x,y}), resumed(x, y, z))") +
+        gather_gen;
+
+    if(options.blocking) {
+        // Tiles are loaded with a halo deep enough to advance them several generations in cache.
+        int reach = std::max(radius, 1);
+        int tile_width = dimensions == 1 ? 4096 : 128;
+        int tile_height = dimensions == 1 ? 1 : 128;
+        int depth = std::max(1, tile_width / (8 * reach));
+        std::string reach_y = dimensions == 1 ? "0" : std::to_string(reach);
+        code = code +
+            "   const int block = " + std::to_string(depth) + ";\n"
+            "   " + std::string(options.batch ? "static thread_local " : "") + "std::vector<uint8_t> a;\n"
+            "   " + std::string(options.batch ? "static thread_local " : "") + "std::vector<uint8_t> b;\n"
+            "   int generations = 0;\n"
+            "   for(; t < steps; t += generations) {\n" +
+            std::string(skipping() ? "       uint64_t hash = 0;\n" : "") +
+            "       generations = std::min(block, steps - t);\n"
+            "       // Blocks end where checkpoints and frames are due, so they are written at the generations asked for.\n"
+            "       if(checkpoint_every > 0) {\n"
+            "           generations = std::min(generations, checkpoint_every - t % checkpoint_every);\n"
+            "       }\n"
+            "       if(frame_every > 0) {\n"
+            "           generations = std::min(generations, frame_every - t % frame_every);\n"
+            "       }\n"
+            "       int halo_x = generations * " + std::to_string(reach) + ";\n"
+            "       int halo_y = generations * " + reach_y + ";\n" +
+            std::string(options.statistics ? "       std::vector<Tally> tallies(gathering ? generations : 0);\n" : "") +
+            "       for(int ty = 0; ty < height; ty += " + std::to_string(tile_height) + ") {\n"
+            "       for(int tx = 0; tx < width; tx += " + std::to_string(tile_width) + ") {\n"
+            "           int w = std::min(" + std::to_string(tile_width) + ", width - tx) + 2 * halo_x;\n"
+            "           int h = std::min(" + std::to_string(tile_height) + ", height - ty) + 2 * halo_y;\n"
+            "           a.resize(w * h);\n"
+            "           b.resize(w * h);\n"
+            "           for(int ly = 0; ly < h; ly++) {\n"
+            "               for(int lx = 0; lx < w; lx++) {\n"
+            "                   a[ly * w + lx] = prev[coordinate2d({wrap(tx + lx - halo_x, width), wrap(ty + ly - halo_y, height)})];\n"
+            "               }\n"
+            "           }\n"
+            "           // The valid region shrinks by the radius each generation.\n"
+            "           for(int s = 1; s <= generations; s++) {\n"
+            "               int sx = s * " + std::to_string(reach) + ";\n"
+            "               int sy = s * " + reach_y + ";\n"
+            "               for(int ly = sy; ly < h - sy; ly++) {\n"
+            "                   for(int lx = sx; lx < w - sx; lx++) {\n"
+            "                       int current = ly * w + lx;\n"
+            "                       b[current] = " + model_id + "_rule(Local{a.data(), w, 0, current},\n"
+            "                           Dice{t + s - 1, wrap(tx + lx - halo_x, width), wrap(ty + ly - halo_y, height), 0});\n" +
+            tallyCode("                       ", "gathering && ly >= halo_y && ly < h - halo_y && lx >= halo_x && lx < w - halo_x",
+                "tallies[s - 1]", "tx + lx - halo_x", "ty + ly - halo_y", "0", "b[current]") +
+            "                   }\n"
+            "               }\n"
+            "               std::swap(a, b);\n"
+            "           }\n"
+            "           for(int ly = halo_y; ly < h - halo_y; ly++) {\n"
+            "               for(int lx = halo_x; lx < w - halo_x; lx++) {\n"
+            "                   size_t current = coordinate2d({tx + lx - halo_x, ty + ly - halo_y});\n"
+            "                   next.set(current, a[ly * w + lx]);\n" +
+            std::string(skipping() ? "                   hash += cellHash(current, a[ly * w + lx]);\n" : "") +
+            "               }\n"
+            "           }\n"
+            "       }\n"
+            "       }\n"
+            "       std::swap(next, prev);\n" +
+            std::string(options.statistics ?
+            "       for(int s = 0; s < (int) tallies.size(); s++) {\n"
+            "           if(!statistics.write(t + s + 1, tallies[s])) {\n"
+            "               return \"Error: Unable to write STATS.\";\n"
+            "           }\n"
+            "       }\n" : "") +
+            checkpointCode("t", "(t + generations)", "prev[coordinate2d({x,y})]") +
+            frameCode("t", "(t + generations)", "prev[coordinate2d({x,y})]") +
+            cycleCode("t", "(t + generations)", "prev.data()") +
+            "   }\n";
+    } else {
+        if(options.width > 0 && !options.morton) {
+            // Grids of the size given to emergent sweep with their dimensions as constants, leaving none to run after.
+            code = code +
+                "   if(width == FIXED_WIDTH && height == FIXED_HEIGHT) {\n"
+                "   for(; t < steps; t++) {\n" +
+                std::string(skipping() ? "       uint64_t hash = 0;\n" : "") +
+                std::string(options.statistics ? "       Tally tally;\n" : "") +
+                "       for(int y = 0; y < FIXED_HEIGHT; y++) {\n"
+                "       for(int x = 0; x < FIXED_WIDTH; x++) {\n"
+                "           size_t current = (size_t) y * FIXED_WIDTH + x;\n"
+                "           uint8_t state = " + model_id + "_rule(Fixed<" + grid + ">{prev, x, y, current}, Dice{t, x, y, 0});\n"
+                "           next.set(current, state);\n" +
+                std::string(skipping() ? "           hash += cellHash(current, state);\n" : "") +
+                tallyCode("           ", "gathering", "tally", "x", "y", "0", "state") +
+                "       }\n"
+                "       }\n"
+                "       std::swap(next, prev);\n" +
+                statsCode("(t + 1)", "tally") +
+                checkpointCode("t", "(t + 1)", "prev[(size_t) y * FIXED_WIDTH + x]") +
+                frameCode("t", "(t + 1)", "prev[(size_t) y * FIXED_WIDTH + x]") +
+                cycleCode("t", "(t + 1)", "prev.data()") +
+                "   }\n"
+                "   }\n";
+        }
+        code = code +
+            "   for(; t < steps; t++) {\n" +
+            std::string(skipping() ? "       uint64_t hash = 0;\n" : "") +
+            std::string(options.statistics ? "       Tally tally;\n" : "");
+        std::string ending_brace;
+        if(options.morton) {
+            // Sweeps tile by tile, so neighbours read are close in Z-order.
+            code = code +
+                "       for(int ty = 0; ty < height; ty += TILE) {\n"
+                "       for(int tx = 0; tx < width; tx += TILE) {\n"
+                "       for(int y = ty; y < std::min(ty + TILE, height); y++) {\n"
+                "       for(int x = tx; x < std::min(tx + TILE, width); x++) {\n";
+            ending_brace =
+                "       }\n"
+                "       }\n"
+                "       }\n";
+        } else {
+            code = code +
+                "       for(int y = 0; y < height; y++) {\n"
+                "       for(int x = 0; x < width; x++) {\n";
+            ending_brace = 
+                "       }\n";
+        }
+        code = code +
+            "           size_t current = coordinate2d({x,y});\n"
+            "           uint8_t state = " + model_id + "_rule(Wrapped<" + grid + ">{prev, x, y, current}, Dice{t, x, y, 0});\n"
+            "           next.set(current, state);\n" +
+            std::string(skipping() ? "           hash += cellHash(current, state);\n" : "") +
+            tallyCode("           ", "gathering", "tally", "x", "y", "0", "state") +
+            ending_brace +
+            "       }\n"
+            "       std::swap(next, prev);\n" +
+            statsCode("(t + 1)", "tally") +
+            checkpointCode("t", "(t + 1)", "prev[coordinate2d({x,y})]") +
+            frameCode("t", "(t + 1)", "prev[coordinate2d({x,y})]") +
+            cycleCode("t", "(t + 1)", "prev.data()") +
+            "   }\n";
+    }
+
+    code = code +
+        finishCode() +
+        "   decode(states, prev);\n"
         "   return \"\";\n"
         "}\n";
     local_states.clear();
+    state_indices.clear();
     current_neighbourhood = nullptr;
+    radius = std::max(outer_radius, radius);
     return code;
 }
 
@@ -244,31 +995,42 @@ std::string ast::Neighbour::codegen() {
 }
 
 std::string ast::Neighbourhood::codegen() {
+    int outer_radius = radius;
+    radius = 0;
     std::string code = neighbours->codegen();
     if(code == "") {
         return "";
     }
+    neighbourhood_radii[id] = radius;
+    radius = std::max(outer_radius, radius);
+    // Offsets are constant arrays, so loops over them unroll into constant offsets from the cell.
+    std::string size = std::to_string(neighbours->items.size());
     if(dimensions == 1) {
         return 
-            "std::vector<int> " + id + " = std::vector<int> {\n"
+            "constexpr std::array<int, " + size + "> " + id + " = {{\n"
             "   " + code + "\n"
-            "};\n"; 
+            "}};\n"; 
     } else if(dimensions == 2) {
         return
-            "std::vector<std::pair<int,int>> " + id + " = std::vector<std::pair<int,int>> {\n"
+            "constexpr std::array<std::pair<int,int>, " + size + "> " + id + " = {{\n"
             "   " + code + "\n"
-            "};\n";
+            "}};\n";
+    } else if(dimensions == 3) {
+        return
+            "constexpr std::array<std::array<int,3>, " + size + "> " + id + " = {{\n"
+            "   " + code + "\n"
+            "}};\n";
     }
-    SemanticError("Neighbourhood", "Neighbourhood's dimensions must be 1 or 2.");
+    SemanticError("Neighbourhood", "Neighbourhood's dimensions must be 1, 2 or 3.");
     return "";
     
 }
 
-std::string ast::Program::codegen() {  
-    // Output preamble, neighbourhoods_gen, models_gen, main_a, cases, main_b
-
-    std::string preamble = 
+// Headers included by every simulator.
+std::string includes() {
+    return
         "#include <iostream>\n"
+        "#include <deque>\n"
         "#include <string.h>\n"
         "#include <string>\n"
         "#include <system_error>\n"
@@ -276,23 +1038,838 @@ std::string ast::Program::codegen() {
         "#include <algorithm>\n"
         "#include <memory>\n"
         "#include <utility>\n"
+        "#include <stdint.h>\n"
+        "#include <array>\n"
+        "#include <thread>\n"
+        "#include <atomic>\n"
+        "#include <chrono>\n"
+        "#include <fcntl.h>\n"
+        "#include <sys/mman.h>\n"
+        "#include <sys/stat.h>\n"
+        "#include <unistd.h>\n"
+        "#include <unordered_map>\n"
+        "#include <unordered_set>\n"
+        "#include <mutex>\n"
+        ;
+}
 
-        "int steps = 0;\n"
-        "std::string name;\n"
-        "std::vector<char> prev;\n"
-        "int width = 0;\n"
-        "int height = 0;\n"
-        "int coordinate1d(int x) {\n"
-        " return x % width;\n"
+// Split simulators define the runtime in a header included by every unit, so its globals and functions are inline.
+std::string linkage() {
+    return options.split != "" ? "inline " : "";
+}
+
+// Runtime built whole for simulators and, at once, as the header and source of libemergent.a,
+// which declare globals and functions in the header and define them in the source.
+struct SharedRuntime {
+    std::string whole, header, source;
+    // Comments, templates, classes, constants and inline functions, which every unit may define alike.
+    void code(const std::string &text) {
+        whole = whole + text;
+        header = header + text;
+    }
+    // A global, with its initial value if any.
+    void global(const std::string &declaration, const std::string &value = "") {
+        std::string definition = declaration + (value == "" ? "" : " = " + value) + ";\n";
+        whole = whole + linkage() + definition;
+        header = header + "extern " + declaration + ";\n";
+        source = source + definition;
+    }
+    // A function, given its signature and the statements of its body.
+    void function(const std::string &signature, const std::string &body) {
+        std::string definition = signature + " {\n" + body + "}\n";
+        whole = whole + linkage() + definition;
+        header = header + signature + ";\n";
+        source = source + definition;
+    }
+};
+
+// Parts of the runtime which are the same for every model, and so may be prebuilt as a library.
+SharedRuntime sharedRuntime() {
+    // Batches simulate a grid per thread, so whatever describes the grid is kept per thread.
+    std::string tls = options.batch ? "thread_local " : "";
+    SharedRuntime runtime;
+    runtime.global("int steps", "0");
+    runtime.global("std::string name");
+    runtime.global(tls + "std::string input_name");
+    runtime.global(tls + "std::string output_name");
+    runtime.global(tls + "std::vector<char> characters");
+    runtime.global(tls + "int width", "0");
+    runtime.global(tls + "int height", "0");
+    runtime.global(tls + "int depth", "0");
+    runtime.global(tls + "size_t capacity", "0");
+    runtime.code(
+        "inline int wrap(int i, int length) {\n"
+        "    return ((i % length) + length) % length;\n"
+        "}\n"
+        "// Counts the offsets in list for which f holds, list being evaluated once.\n"
+        "template<typename List, typename F>\n"
+        "int countIf(const List &list, F f) {\n"
+        "    return std::count_if(list.begin(), list.end(), f);\n"
+        "}\n"
+        "inline int coordinate1d(int x) {\n"
+        " return wrap(x, width);\n"
+        "}\n");
+    runtime.global("uint64_t seed", "0");
+    runtime.code(
+        "inline uint64_t mix(uint64_t h) {\n"
+        "    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;\n"
+        "    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;\n"
+        "    return h ^ (h >> 31);\n"
+        "}\n"
+        "// Draws numbers uniformly from [0, 1) for the cell (x, y, z) in generation t. Each draw is a hash of the\n"
+        "// seed, generation, cell, draw and offset, so runs repeat exactly whatever the threads, tiles or shards.\n"
+        "struct Dice {\n"
+        "    int64_t t, x, y, z;\n"
+        "    double operator()(int draw, int dx = 0, int dy = 0, int dz = 0) const {\n"
+        "        uint64_t h = mix(mix(mix(mix(seed + 0x9E3779B97F4A7C15ull) ^ t) ^ x) ^ y);\n"
+        "        h = mix(h ^ z);\n"
+        "        h = mix(h ^ ((uint64_t) (uint16_t) draw | (uint64_t) (uint16_t) dx << 16 |\n"
+        "            (uint64_t) (uint16_t) dy << 32 | (uint64_t) (uint16_t) dz << 48));\n"
+        "        return (h >> 11) * 0x1.0p-53;\n"
+        "    }\n"
+        "};\n");
+    if(options.batch) {
+        runtime.global("bool batch", "false");
+    }
+    runtime.code(
+        std::string(options.batch ?
+        "// Starts a thread on f, sharing the dimensions of the grid of the thread starting it.\n"
+        "template<typename F>\n"
+        "std::thread spawn(F f) {\n"
+        "    int w = width, h = height, d = depth;\n"
+        "    size_t c = capacity;\n"
+        "    return std::thread([=]() {\n"
+        "        width = w;\n"
+        "        height = h;\n"
+        "        depth = d;\n"
+        "        capacity = c;\n"
+        "        f();\n"
+        "    });\n"
+        "}\n" :
+        "template<typename F>\n"
+        "std::thread spawn(F f) {\n"
+        "    return std::thread(f);\n"
+        "}\n") +
+        "// Runs body(begin, end) over slabs of [0, length), a thread per slab.\n"
+        "template<typename F>\n"
+        "void parallel(int length, F body) {\n" +
+        std::string(options.batch ?
+        "    // Batches already keep every thread busy with jobs of their own.\n"
+        "    if(batch) {\n"
+        "        body(0, length);\n"
+        "        return;\n"
+        "    }\n" : "") +
+        "    int threads = std::min<int>(std::max(1u, std::thread::hardware_concurrency()), length);\n"
+        "    std::vector<std::thread> pool;\n"
+        "    for(int i = 0; i < threads; i++) {\n"
+        "        int begin = length * i / threads;\n"
+        "        int end = length * (i + 1) / threads;\n"
+        "        pool.push_back(spawn([=]() {\n"
+        "            body(begin, end);\n"
+        "        }));\n"
+        "    }\n"
+        "    for(auto &thread : pool) {\n"
+        "        thread.join();\n"
+        "    }\n"
         "}\n"
-        "std::vector<int> vec1d(std::vector<int> l) { return l; };\n"
-        "std::vector<std::pair<int,int>> vec2d(std::vector<std::pair<int,int>> l) { return l; };\n"
-        "int coordinate2d(std::pair<int,int> p) {\n"
-        "    return (p.first \% height) + (width * (p.second \% height));\n"
+        "const int TILE3D = 16;\n"
+        "// Copies the cells opposite each face into the halo, so the padded grid wraps around.\n");
+    runtime.function("void wrapHalo(std::vector<uint8_t> &grid, int r)",
+        "    int stride = width + 2 * r;\n"
+        "    size_t plane = (size_t) stride * (height + 2 * r);\n"
+        "    for(int z = r; z < depth + r; z++) {\n"
+        "        for(int y = r; y < height + r; y++) {\n"
+        "            uint8_t *row = &grid[z * plane + y * stride];\n"
+        "            for(int i = 0; i < r; i++) {\n"
+        "                row[i] = row[width + i];\n"
+        "                row[width + r + i] = row[r + i];\n"
+        "            }\n"
+        "        }\n"
+        "        for(int i = 0; i < r; i++) {\n"
+        "            std::copy_n(&grid[z * plane + (height + i) * stride], stride, &grid[z * plane + i * stride]);\n"
+        "            std::copy_n(&grid[z * plane + (r + i) * stride], stride, &grid[z * plane + (height + r + i) * stride]);\n"
+        "        }\n"
+        "    }\n"
+        "    for(int i = 0; i < r; i++) {\n"
+        "        std::copy_n(&grid[(depth + i) * plane], plane, &grid[i * plane]);\n"
+        "        std::copy_n(&grid[(r + i) * plane], plane, &grid[(depth + r + i) * plane]);\n"
+        "    }\n");
+    runtime.function("bool encodePadded(const std::vector<char> &states, std::vector<uint8_t> &grid, int r)",
+        "    uint8_t indices[256];\n"
+        "    memset(indices, 0xFF, sizeof(indices));\n"
+        "    for(int i = 0; i < (int) states.size(); i++) {\n"
+        "        indices[(unsigned char) states[i]] = i;\n"
+        "    }\n"
+        "    int stride = width + 2 * r;\n"
+        "    size_t plane = (size_t) stride * (height + 2 * r);\n"
+        "    for(int z = 0; z < depth; z++) {\n"
+        "        for(int y = 0; y < height; y++) {\n"
+        "            for(int x = 0; x < width; x++) {\n"
+        "                uint8_t state = indices[(unsigned char) characters[((size_t) z * height + y) * width + x]];\n"
+        "                if(state == 0xFF) {\n"
+        "                    return false;\n"
+        "                }\n"
+        "                grid[(z + r) * plane + (y + r) * stride + x + r] = state;\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "    return true;\n");
+    runtime.function("void decodePadded(const std::vector<char> &states, const std::vector<uint8_t> &grid, int r)",
+        "    int stride = width + 2 * r;\n"
+        "    size_t plane = (size_t) stride * (height + 2 * r);\n"
+        "    for(int z = 0; z < depth; z++) {\n"
+        "        for(int y = 0; y < height; y++) {\n"
+        "            for(int x = 0; x < width; x++) {\n"
+        "                characters[((size_t) z * height + y) * width + x] = states[grid[(z + r) * plane + (y + r) * stride + x + r]];\n"
+        "            }\n"
+        "        }\n"
+        "    }\n");
+    runtime.code(
+        "// Checkpoints hold the generation reached, the seed of the dice and a byte per cell,\n"
+        "// in row-major order whatever the layout.\n"
+        "struct CheckpointHeader {\n"
+        "    char magic[8];\n"
+        "    int32_t width, height, depth, states;\n"
+        "    int64_t generation;\n"
+        "    uint64_t seed;\n"
+        "};\n");
+    runtime.global("std::string checkpoint_name");
+    runtime.global("int checkpoint_every", "0");
+    runtime.global("std::string resume_name");
+    runtime.code(
+        "// Writes checkpoints on a background thread, so generations carry on while they reach the disk.\n"
+        "class Checkpointer {\n"
+        "    std::vector<uint8_t> cells;\n"
+        "    std::thread writer;\n"
+        "    bool failed = false;\n"
+        "    void write(int64_t generation, int states) {\n"
+        "        CheckpointHeader header = {{\'E\', \'M\', \'G\', \'C\', \'K\', \'P\', \'T\', \'2\'}, width, height, depth, states, generation, seed};\n"
+        "        // Written beside the checkpoint then renamed over it, so a crash never leaves half a checkpoint.\n"
+        "        std::string temporary = checkpoint_name + \".tmp\";\n"
+        "        FILE *file = fopen(temporary.c_str(), \"wb\");\n"
+        "        if(file == NULL) {\n"
+        "            failed = true;\n"
+        "            return;\n"
+        "        }\n"
+        "        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&\n"
+        "            fwrite(cells.data(), 1, cells.size(), file) == cells.size() &&\n"
+        "            fflush(file) == 0 && fsync(fileno(file)) == 0;\n"
+        "        written = fclose(file) == 0 && written;\n"
+        "        if(!written || rename(temporary.c_str(), checkpoint_name.c_str()) != 0) {\n"
+        "            failed = true;\n"
+        "        }\n"
+        "    }\n"
+        "  public:\n"
+        "    ~Checkpointer() {\n"
+        "        finish();\n"
+        "    }\n"
+        "    // Copies every cell(x, y, z) and writes them once the previous checkpoint is written.\n"
+        "    template<typename F>\n"
+        "    bool save(int64_t generation, int states, F cell) {\n"
+        "        if(!finish()) {\n"
+        "            return false;\n"
+        "        }\n"
+        "        cells.resize((size_t) width * height * depth);\n"
+        "        size_t i = 0;\n"
+        "        for(int z = 0; z < depth; z++) {\n"
+        "            for(int y = 0; y < height; y++) {\n"
+        "                for(int x = 0; x < width; x++) {\n"
+        "                    cells[i++] = cell(x, y, z);\n"
+        "                }\n"
+        "            }\n"
+        "        }\n"
+        "        writer = spawn([=]() {\n"
+        "            write(generation, states);\n"
+        "        });\n"
+        "        return true;\n"
+        "    }\n"
+        "    // Waits for the checkpoint being written, returning whether every checkpoint was written.\n"
+        "    bool finish() {\n"
+        "        if(writer.joinable()) {\n"
+        "            writer.join();\n"
+        "        }\n"
+        "        return !failed;\n"
+        "    }\n"
+        "};\n"
+        "// Maps the checkpoint to resume from, checking it was taken of a grid like this one.\n"
+        "class Resumed {\n"
+        "    void *map = MAP_FAILED;\n"
+        "    size_t length = 0;\n"
+        "  public:\n"
+        "    const char *error = \"\";\n"
+        "    int64_t generation = 0;\n"
+        "    const uint8_t *cells = nullptr;\n"
+        "    Resumed(int states) {\n"
+        "        int fd = ::open(resume_name.c_str(), O_RDONLY);\n"
+        "        struct stat info;\n"
+        "        if(fd < 0 || fstat(fd, &info) != 0) {\n"
+        "            error = \"Error: Unable to open the checkpoint to resume.\";\n"
+        "            if(fd >= 0) {\n"
+        "                close(fd);\n"
+        "            }\n"
+        "            return;\n"
+        "        }\n"
+        "        length = info.st_size;\n"
+        "        size_t expected = sizeof(CheckpointHeader) + (size_t) width * height * depth;\n"
+        "        if(length == expected) {\n"
+        "            map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);\n"
+        "        }\n"
+        "        close(fd);\n"
+        "        if(map == MAP_FAILED) {\n"
+        "            error = \"Error: The checkpoint does not match INPUT.\";\n"
+        "            return;\n"
+        "        }\n"
+        "        const CheckpointHeader *header = (const CheckpointHeader *) map;\n"
+        "        if(memcmp(header->magic, \"EMGCKPT2\", 8) != 0 || header->width != width || header->height != height ||\n"
+        "                header->depth != depth || header->states != states || header->generation > steps) {\n"
+        "            error = \"Error: The checkpoint does not match INPUT.\";\n"
+        "            return;\n"
+        "        }\n"
+        "        generation = header->generation;\n"
+        "        // Resumed runs carry on drawing from the dice they were checkpointed with.\n"
+        "        seed = header->seed;\n"
+        "        cells = (const uint8_t *) map + sizeof(CheckpointHeader);\n"
+        "        for(size_t i = 0; i < length - sizeof(CheckpointHeader); i++) {\n"
+        "            if(cells[i] >= states) {\n"
+        "                error = \"Error: Unrecognised state within the checkpoint.\";\n"
+        "                return;\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "    ~Resumed() {\n"
+        "        if(map != MAP_FAILED) {\n"
+        "            munmap(map, length);\n"
+        "        }\n"
+        "    }\n"
+        "    uint8_t operator()(int x, int y, int z) const {\n"
+        "        return cells[((size_t) z * height + y) * width + x];\n"
+        "    }\n"
+        "};\n"
+        "// Frames are written every frame_every generations, to frame_pattern with its #s replaced by the generation,\n"
+        "// as binary PPM if it ends in .ppm, as PNG if it ends in .png, otherwise as text.\n");
+    runtime.global("std::string frame_pattern");
+    runtime.global("int frame_every", "0");
+    runtime.code(
+        "// Frames hold the region_width by region_height cells from (region_x, region_y), or all of them if 0,\n"
+        "// each block of downsample by downsample cells drawn as its most common state, or its density if set.\n");
+    runtime.global("int region_x", "0");
+    runtime.global("int region_y", "0");
+    runtime.global("int region_width", "0");
+    runtime.global("int region_height", "0");
+    runtime.global("int downsample", "1");
+    runtime.global("bool density", "false");
+    runtime.code(
+        "// Names the frame of a generation, zero padding it to the length of the run of #s.\n");
+    runtime.function("std::string frameName(int64_t generation)",
+        "    size_t end = frame_pattern.find_last_of('#') + 1;\n"
+        "    size_t begin = frame_pattern.find_last_not_of('#', end - 1) + 1;\n"
+        "    std::string number = std::to_string(generation);\n"
+        "    if(number.size() < end - begin) {\n"
+        "        number = std::string(end - begin - number.size(), '0') + number;\n"
+        "    }\n"
+        "    return frame_pattern.substr(0, begin) + number + frame_pattern.substr(end);\n");
+    runtime.function("void putBigEndian(std::string &bytes, uint32_t n)",
+        "    for(int shift = 24; shift >= 0; shift -= 8) {\n"
+        "        bytes += (char) (n >> shift);\n"
+        "    }\n");
+    runtime.code(
+        "// CRC-32 of bytes from begin, as PNG chunks end with.\n");
+    runtime.function("uint32_t pngCrc(const std::string &bytes, size_t begin)",
+        "    static const std::array<uint32_t, 256> table = []() {\n"
+        "        std::array<uint32_t, 256> table;\n"
+        "        for(uint32_t n = 0; n < 256; n++) {\n"
+        "            uint32_t c = n;\n"
+        "            for(int k = 0; k < 8; k++) {\n"
+        "                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;\n"
+        "            }\n"
+        "            table[n] = c;\n"
+        "        }\n"
+        "        return table;\n"
+        "    }();\n"
+        "    uint32_t c = 0xFFFFFFFFu;\n"
+        "    for(size_t i = begin; i < bytes.size(); i++) {\n"
+        "        c = table[(c ^ (unsigned char) bytes[i]) & 0xFF] ^ (c >> 8);\n"
+        "    }\n"
+        "    return c ^ 0xFFFFFFFFu;\n");
+    runtime.code(
+        "// Encodes w by h RGB pixels as PNG, in deflate blocks left uncompressed so that no library is needed.\n");
+    runtime.function("std::string encodePng(const std::vector<uint8_t> &rgb, int w, int h)",
+        "    // Each scanline is led by its filter, 0 for none.\n"
+        "    std::string raw;\n"
+        "    raw.reserve((size_t) (w * 3 + 1) * h);\n"
+        "    for(int y = 0; y < h; y++) {\n"
+        "        raw += \'\\0\';\n"
+        "        raw.append((const char *) &rgb[(size_t) y * w * 3], (size_t) w * 3);\n"
+        "    }\n"
+        "    std::string data = \"\\x78\\x01\";\n"
+        "    for(size_t i = 0; i < raw.size(); i += 65535) {\n"
+        "        size_t n = std::min<size_t>(65535, raw.size() - i);\n"
+        "        data += (char) (i + n == raw.size());\n"
+        "        data += (char) n;\n"
+        "        data += (char) (n >> 8);\n"
+        "        data += (char) ~n;\n"
+        "        data += (char) (~n >> 8);\n"
+        "        data.append(raw, i, n);\n"
+        "    }\n"
+        "    // Adler-32, reduced only as often as its sums could overflow.\n"
+        "    uint32_t a = 1, b = 0;\n"
+        "    for(size_t i = 0; i < raw.size(); i += 5552) {\n"
+        "        for(size_t j = i; j < std::min(raw.size(), i + 5552); j++) {\n"
+        "            a += (unsigned char) raw[j];\n"
+        "            b += a;\n"
+        "        }\n"
+        "        a %= 65521;\n"
+        "        b %= 65521;\n"
+        "    }\n"
+        "    putBigEndian(data, b << 16 | a);\n"
+        "    std::string png = \"\\x89PNG\\r\\n\\x1A\\n\";\n"
+        "    auto chunk = [&](const char *type, const std::string &body) {\n"
+        "        putBigEndian(png, body.size());\n"
+        "        size_t begin = png.size();\n"
+        "        png += type;\n"
+        "        png += body;\n"
+        "        putBigEndian(png, pngCrc(png, begin));\n"
+        "    };\n"
+        "    std::string header;\n"
+        "    putBigEndian(header, w);\n"
+        "    putBigEndian(header, h);\n"
+        "    header += std::string(\"\\x08\\x02\\x00\\x00\\x00\", 5);\n"
+        "    chunk(\"IHDR\", header);\n"
+        "    chunk(\"IDAT\", data);\n"
+        "    chunk(\"IEND\", \"\");\n"
+        "    return png;\n");
+    runtime.code(
+        "// Writes a frame of the states in view, or their densities in percent, columns by rows a layer.\n");
+    runtime.function("bool writeFrame(int64_t generation, const std::vector<uint8_t> &view, int columns, int rows,\n"
+        "        const std::vector<char> &states, const std::vector<uint32_t> &colours)",
+        "    std::string name = frameName(generation);\n"
+        "    bool ppm = name.size() >= 4 && name.compare(name.size() - 4, 4, \".ppm\") == 0;\n"
+        "    bool png = name.size() >= 4 && name.compare(name.size() - 4, 4, \".png\") == 0;\n"
+        "    std::string bytes;\n"
+        "    if(ppm || png) {\n"
+        "        // Each pixel is copied as four bytes of the palette, the fourth overwritten by the next pixel,\n"
+        "        // so the lookup is a load and a store whatever the colour.\n"
+        "        uint8_t palette[256][4] = {};\n"
+        "        for(int i = 0; i < 256; i++) {\n"
+        "            uint32_t colour = density ? (std::min(i, 100) * 255 / 100) * 0x010101u : i < (int) colours.size() ? colours[i] : 0;\n"
+        "            palette[i][0] = colour >> 16;\n"
+        "            palette[i][1] = colour >> 8;\n"
+        "            palette[i][2] = colour;\n"
+        "        }\n"
+        "        std::vector<uint8_t> rgb(view.size() * 3 + 1);\n"
+        "        for(size_t i = 0; i < view.size(); i++) {\n"
+        "            memcpy(&rgb[i * 3], palette[view[i]], 4);\n"
+        "        }\n"
+        "        rgb.pop_back();\n"
+        "        // Layers of a 3D grid are stacked down the image.\n"
+        "        if(ppm) {\n"
+        "            bytes = \"P6\\n\" + std::to_string(columns) + \" \" + std::to_string(rows * depth) + \"\\n255\\n\";\n"
+        "            bytes.append((const char *) rgb.data(), rgb.size());\n"
+        "        } else {\n"
+        "            bytes = encodePng(rgb, columns, rows * depth);\n"
+        "        }\n"
+        "    } else {\n"
+        "        bytes.reserve(view.size() + (size_t) rows * depth + depth);\n"
+        "        for(size_t i = 0; i < view.size(); i++) {\n"
+        "            if(i > 0 && i % ((size_t) columns * rows) == 0) {\n"
+        "                bytes += \'\\n\';\n"
+        "            }\n"
+        "            bytes += density ? (char) ('0' + std::min(9, view[i] / 10)) : states[view[i]];\n"
+        "            if((i + 1) % columns == 0) {\n"
+        "                bytes += \'\\n\';\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "    FILE *file = fopen(name.c_str(), \"wb\");\n"
+        "    if(file == NULL) {\n"
+        "        return false;\n"
+        "    }\n"
+        "    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();\n"
+        "    return fclose(file) == 0 && written;\n");
+    runtime.code(
+        "// Draws frames as the grid is simulated, writing them on a background thread as checkpoints are.\n"
+        "class Framer {\n"
+        "    std::vector<uint8_t> view;\n"
+        "    std::thread writer;\n"
+        "    bool failed = false;\n"
+        "  public:\n"
+        "    ~Framer() {\n"
+        "        finish();\n"
+        "    }\n"
+        "    // Draws the region of the grid through cell(x, y, z), reading only the cells within it,\n"
+        "    // and writes it once the previous frame is written.\n"
+        "    template<typename F>\n"
+        "    bool save(int64_t generation, const std::vector<char> &states, const std::vector<uint32_t> &colours,\n"
+        "            uint8_t background, F cell) {\n"
+        "        if(!finish()) {\n"
+        "            return false;\n"
+        "        }\n"
+        "        int w = region_width > 0 ? region_width : width;\n"
+        "        int h = region_height > 0 ? region_height : height;\n"
+        "        int columns = (w + downsample - 1) / downsample;\n"
+        "        int rows = (h + downsample - 1) / downsample;\n"
+        "        view.resize((size_t) columns * rows * depth);\n"
+        "        std::vector<int> counts(states.size());\n"
+        "        size_t i = 0;\n"
+        "        for(int z = 0; z < depth; z++) {\n"
+        "            for(int row = 0; row < rows; row++) {\n"
+        "                for(int column = 0; column < columns; column++) {\n"
+        "                    std::fill(counts.begin(), counts.end(), 0);\n"
+        "                    int y_end = std::min(h, (row + 1) * downsample);\n"
+        "                    int x_end = std::min(w, (column + 1) * downsample);\n"
+        "                    for(int y = row * downsample; y < y_end; y++) {\n"
+        "                        for(int x = column * downsample; x < x_end; x++) {\n"
+        "                            counts[cell(wrap(region_x + x, width), wrap(region_y + y, height), z)]++;\n"
+        "                        }\n"
+        "                    }\n"
+        "                    if(density) {\n"
+        "                        // The percentage of the block outside the background state.\n"
+        "                        int cells = (y_end - row * downsample) * (x_end - column * downsample);\n"
+        "                        view[i++] = (cells - counts[background]) * 100 / cells;\n"
+        "                    } else {\n"
+        "                        view[i++] = std::max_element(counts.begin(), counts.end()) - counts.begin();\n"
+        "                    }\n"
+        "                }\n"
+        "            }\n"
+        "        }\n"
+        "        writer = spawn([=]() {\n"
+        "            failed = !writeFrame(generation, view, columns, rows, states, colours);\n"
+        "        });\n"
+        "        return true;\n"
+        "    }\n"
+        "    // Waits for the frame being written, returning whether every frame was written.\n"
+        "    bool finish() {\n"
+        "        if(writer.joinable()) {\n"
+        "            writer.join();\n"
+        "        }\n"
+        "        return !failed;\n"
+        "    }\n"
+        "};\n");
+    runtime.global("bool map_output", "false");
+    runtime.code(
+        "// Writes OUTPUT a row at a time, each layer of a 3D grid followed by a blank line but the last.\n");
+    runtime.function("bool writeOutput()",
+        "    size_t row = width + 1;\n"
+        "    size_t layer = (size_t) height * row + 1;\n"
+        "    size_t length = characters.empty() ? 0 : depth * layer - 1;\n"
+        "    if(map_output && length > 0) {\n"
+        "        // Rows are copied straight into the mapped file, by as many threads as there are cores.\n"
+        "        int fd = ::open(output_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);\n"
+        "        if(fd < 0 || ftruncate(fd, length) != 0) {\n"
+        "            if(fd >= 0) {\n"
+        "                close(fd);\n"
+        "            }\n"
+        "            return false;\n"
+        "        }\n"
+        "        char *text = (char *) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);\n"
+        "        close(fd);\n"
+        "        if(text == MAP_FAILED) {\n"
+        "            return false;\n"
+        "        }\n"
+        "        parallel(depth * height, [&](int begin, int end) {\n"
+        "            for(int r = begin; r < end; r++) {\n"
+        "                char *out = text + (r / height) * layer + (r % height) * row;\n"
+        "                memcpy(out, &characters[(size_t) r * width], width);\n"
+        "                out[width] = \'\\n\';\n"
+        "                if(r % height == height - 1 && r < depth * height - 1) {\n"
+        "                    out[width + 1] = \'\\n\';\n"
+        "                }\n"
+        "            }\n"
+        "        });\n"
+        "        return munmap(text, length) == 0;\n"
+        "    }\n"
+        "    FILE *output = fopen(output_name.c_str(), \"w\");\n"
+        "    if(output == NULL) {\n"
+        "        return false;\n"
+        "    }\n"
+        "    std::vector<char> text(row);\n"
+        "    text[width] = \'\\n\';\n"
+        "    bool written = true;\n"
+        "    for(int r = 0; r < depth * height && written; r++) {\n"
+        "        if(r > 0 && r % height == 0) {\n"
+        "            written = putc(\'\\n\', output) != EOF;\n"
+        "        }\n"
+        "        memcpy(text.data(), &characters[(size_t) r * width], width);\n"
+        "        written = written && fwrite(text.data(), 1, row, output) == row;\n"
+        "    }\n"
+        "    return fclose(output) == 0 && written;\n");
+    runtime.code(
+        "// Reads a grid of characters, layers of a 3D grid separated by blank lines, keeping them if store is set.\n");
+    runtime.function("const char* readDense(FILE *input, bool store)",
+        "    int pos = 0;\n"
+        "    int rows = 0;\n"
+        "    int c;\n"
+        "    do {\n"
+        "        c = getc(input);\n"
+        "        if(c == \'\\r\') {\n"
+        "            continue;\n"
+        "        }\n"
+        "        if(c != \'\\n\' && c != EOF) {\n"
+        "            if(store) {\n"
+        "                characters.push_back(c);\n"
+        "            }\n"
+        "            pos++;\n"
+        "            continue;\n"
+        "        }\n"
+        "        bool blank = pos == 0;\n"
+        "        if(!blank) {\n"
+        "            if(width == 0) {\n"
+        "                width = pos;\n"
+        "            } else if(pos != width) {\n"
+        "                return \"Error: Contradicing dimensions within INPUT file.\";\n"
+        "            }\n"
+        "            rows++;\n"
+        "            pos = 0;\n"
+        "        }\n"
+        "        if((blank || c == EOF) && rows > 0) {\n"
+        "            if(depth == 0) {\n"
+        "                height = rows;\n"
+        "            } else if(rows != height) {\n"
+        "                return \"Error: Contradicing dimensions within INPUT file.\";\n"
+        "            }\n"
+        "            depth++;\n"
+        "            rows = 0;\n"
+        "        }\n"
+        "    } while(c != EOF);\n"
+        "    return \"\";\n");
+    runtime.code(
+        "// Files ending in .rle hold run-length encoded patterns, as in Life RLE.\n");
+    runtime.function("bool isRle(const std::string &file)",
+        "    return file.size() > 4 && file.compare(file.size() - 4, 4, \".rle\") == 0;\n");
+    runtime.code(
+        "// RLE tags name the default state b or ., and the other states o or A, B, ... up to pX,\n"
+        "// in the order of the palette, which holds the characters of the default state then the others.\n");
+    runtime.function("int rleTag(int prefix, int c)",
+        "    if(c == \'b\' || c == \'.\') {\n"
+        "        return 0;\n"
+        "    }\n"
+        "    if(c == \'o\') {\n"
+        "        return 1;\n"
+        "    }\n"
+        "    if(c >= \'A\' && c <= \'X\') {\n"
+        "        return (prefix == 0 ? 0 : (prefix - \'p\' + 1) * 24) + c - \'A\' + 1;\n"
+        "    }\n"
+        "    return -1;\n");
+    runtime.function("const char* readRle(FILE *input, const std::string &palette)",
+        "    if(palette == \"\") {\n"
+        "        return \"Error: Incorrect 2nd operand MODEL must be a name of a model\";\n"
+        "    }\n"
+        "    int c;\n"
+        "    // Comments precede the header, which gives the dimensions of the grid.\n"
+        "    while((c = getc(input)) == \'#\') {\n"
+        "        while((c = getc(input)) != \'\\n\' && c != EOF);\n"
+        "    }\n"
+        "    ungetc(c, input);\n"
+        "    if(fscanf(input, \" x = %d , y = %d\", &width, &height) != 2 || width <= 0 || height <= 0) {\n"
+        "        return \"Error: Missing the header of the RLE INPUT.\";\n"
+        "    }\n"
+        "    while((c = getc(input)) != \'\\n\' && c != EOF);\n"
+        "    depth = 1;\n"
+        "    characters.assign((size_t) width * height, palette[0]);\n"
+        "    int x = 0, y = 0, count = 0, prefix = 0;\n"
+        "    while((c = getc(input)) != EOF && c != \'!\') {\n"
+        "        if(c >= \'0\' && c <= \'9\') {\n"
+        "            count = count * 10 + c - \'0\';\n"
+        "            continue;\n"
+        "        }\n"
+        "        if(c == \' \' || c == \'\\t\' || c == \'\\r\' || c == \'\\n\') {\n"
+        "            continue;\n"
+        "        }\n"
+        "        if(c >= \'p\' && c <= \'y\') {\n"
+        "            prefix = c;\n"
+        "            continue;\n"
+        "        }\n"
+        "        int run = std::max(count, 1);\n"
+        "        count = 0;\n"
+        "        if(c == \'$\') {\n"
+        "            y += run;\n"
+        "            x = 0;\n"
+        "            continue;\n"
+        "        }\n"
+        "        int state = rleTag(prefix, c);\n"
+        "        prefix = 0;\n"
+        "        if(state < 0 || state >= (int) palette.size()) {\n"
+        "            return \"Error: Unrecognised state within INPUT.\";\n"
+        "        }\n"
+        "        if(x + run > width || y >= height) {\n"
+        "            return \"Error: The RLE INPUT overflows its dimensions.\";\n"
+        "        }\n"
+        "        if(state != 0) {\n"
+        "            memset(&characters[(size_t) y * width + x], palette[state], run);\n"
+        "        }\n"
+        "        x += run;\n"
+        "    }\n"
+        "    return \"\";\n");
+    runtime.code(
+        "// Writes OUTPUT as RLE, a run at a time, leaving out the default state at the ends of rows.\n");
+    runtime.function("bool writeRle(const std::string &palette)",
+        "    std::string tags[256];\n"
+        "    for(int i = 0; i < (int) palette.size(); i++) {\n"
+        "        if(palette.size() <= 2) {\n"
+        "            tags[(unsigned char) palette[i]] = i == 0 ? \"b\" : \"o\";\n"
+        "        } else if(i == 0) {\n"
+        "            tags[(unsigned char) palette[i]] = \".\";\n"
+        "        } else {\n"
+        "            int prefix = (i - 1) / 24;\n"
+        "            tags[(unsigned char) palette[i]] = (prefix > 0 ? std::string(1, \'p\' + prefix - 1) : \"\") + std::string(1, \'A\' + (i - 1) % 24);\n"
+        "        }\n"
+        "    }\n"
+        "    FILE *output = fopen(output_name.c_str(), \"w\");\n"
+        "    if(output == NULL) {\n"
+        "        return false;\n"
+        "    }\n"
+        "    fprintf(output, \"x = %d, y = %d\\n\", width, height);\n"
+        "    // Lines are kept within 70 characters, as is conventional.\n"
+        "    std::string line;\n"
+        "    auto emit = [&](int run, const std::string &tag) {\n"
+        "        std::string item = (run > 1 ? std::to_string(run) : \"\") + tag;\n"
+        "        if(line.size() + item.size() > 70) {\n"
+        "            fprintf(output, \"%s\\n\", line.c_str());\n"
+        "            line.clear();\n"
+        "        }\n"
+        "        line += item;\n"
+        "    };\n"
+        "    int ends = 0;\n"
+        "    for(int y = 0; y < height; y++) {\n"
+        "        const char *row = &characters[(size_t) y * width];\n"
+        "        int end = width;\n"
+        "        while(end > 0 && row[end - 1] == palette[0]) {\n"
+        "            end--;\n"
+        "        }\n"
+        "        ends += y > 0;\n"
+        "        if(end == 0) {\n"
+        "            continue;\n"
+        "        }\n"
+        "        if(ends > 0) {\n"
+        "            emit(ends, \"$\");\n"
+        "            ends = 0;\n"
+        "        }\n"
+        "        for(int x = 0; x < end;) {\n"
+        "            int run = 1;\n"
+        "            while(x + run < end && row[x + run] == row[x]) {\n"
+        "                run++;\n"
+        "            }\n"
+        "            emit(run, tags[(unsigned char) row[x]]);\n"
+        "            x += run;\n"
+        "        }\n"
+        "    }\n"
+        "    emit(1, \"!\");\n"
+        "    fprintf(output, \"%s\\n\", line.c_str());\n"
+        "    return fclose(output) == 0;\n");
+    return runtime;
+}
+
+// Splits the shared runtime into a header and a source, for the Makefile to build into libemergent.a.
+std::map<std::string, std::string> ast::runtimeLibrary() {
+    SharedRuntime runtime = sharedRuntime();
+    return {
+        {".hpp", "#pragma once\n#define EMERGENT_RUNTIME " + std::to_string(RUNTIME_VERSION) + "\n" + includes() + runtime.header},
+        {".cpp", "#include \"runtime.hpp\"\n" + runtime.source}
+    };
+}
+
+std::string ast::Program::codegen() {  
+    // Output preamble, neighbourhoods_gen, models_gen, main_a, cases, main_b
+
+    // Batches simulate a grid per thread, so whatever describes the grid is kept per thread.
+    std::string tls = options.batch ? "thread_local " : "";
+    std::string preamble = includes();
+    // Simulators linking the prebuilt runtime only include its declarations.
+    std::string shared = options.library != "" ?
+        "#include \"runtime.hpp\"\n"
+        "#if EMERGENT_RUNTIME != " + std::to_string(RUNTIME_VERSION) + "\n"
+        "#error \"runtime.hpp is of another version of Emergent, so rebuild libemergent.a\"\n"
+        "#endif\n" : sharedRuntime().whole;
+
+    std::string runtime =
+        "template<int BITS>\n"
+        "class Grid {\n"
+        "    static const int PER_BYTE = 8 / BITS;\n"
+        "    static const uint8_t MASK = (1 << BITS) - 1;\n"
+        "    std::vector<uint8_t> bytes;\n"
+        "    size_t cells;\n"
+        "  public:\n"
+        "    Grid(size_t cells) : bytes((cells + PER_BYTE - 1) / PER_BYTE), cells(cells) {};\n"
+        "    size_t size() const {\n"
+        "        return cells;\n"
+        "    }\n"
+        "    // Clears the grid to hold the given number of cells, reusing its bytes.\n"
+        "    void reset(size_t cells) {\n"
+        "        bytes.assign((cells + PER_BYTE - 1) / PER_BYTE, 0);\n"
+        "        this->cells = cells;\n"
+        "    }\n"
+        "    uint8_t operator[](size_t i) const {\n"
+        "        return (bytes[i / PER_BYTE] >> ((i % PER_BYTE) * BITS)) & MASK;\n"
+        "    }\n"
+        "    const std::vector<uint8_t> &data() const {\n"
+        "        return bytes;\n"
+        "    }\n"
+        "    void set(size_t i, uint8_t state) {\n"
+        "        uint8_t &byte = bytes[i / PER_BYTE];\n"
+        "        int shift = (i % PER_BYTE) * BITS;\n"
+        "        byte = (byte & ~(MASK << shift)) | (state << shift);\n"
+        "    }\n"
+        "};\n"
+        "// Reads cells relative to (x, y), wrapping around the edges of the grid.\n"
+        "template<typename G>\n"
+        "struct Wrapped {\n"
+        "    const G &grid;\n"
+        "    int x, y;\n"
+        "    size_t current;\n"
+        "    uint8_t centre() const {\n"
+        "        return grid[current];\n"
+        "    }\n"
+        "    uint8_t operator()(int dx) const {\n"
+        "        return grid[coordinate1d(x + dx)];\n"
+        "    }\n"
+        "    uint8_t operator()(int dx, int dy) const {\n"
+        "        return grid[coordinate2d({x + dx, y + dy})];\n"
+        "    }\n"
         "};\n"
-        "std::pair<int,int> add_point(std::pair<int,int> l, int x, int y) {\n"
-        "    return std::pair<int,int>{l.first + x, l.second + y};\n"
+        "// Reads cells relative to current, within unpacked cells with the given row and plane strides.\n"
+        "struct Local {\n"
+        "    const uint8_t *cells;\n"
+        "    int stride;\n"
+        "    int64_t plane, current;\n"
+        "    uint8_t centre() const {\n"
+        "        return cells[current];\n"
+        "    }\n"
+        "    uint8_t operator()(int dx) const {\n"
+        "        return cells[current + dx];\n"
+        "    }\n"
+        "    uint8_t operator()(int dx, int dy) const {\n"
+        "        return cells[current + dy * stride + dx];\n"
+        "    }\n"
+        "    uint8_t operator()(int dx, int dy, int dz) const {\n"
+        "        return cells[current + dz * plane + dy * stride + dx];\n"
+        "    }\n"
         "};\n"
+        "template<int BITS>\n"
+        "bool encode(const std::vector<char> &states, Grid<BITS> &grid) {\n"
+        "    uint8_t indices[256];\n"
+        "    memset(indices, 0xFF, sizeof(indices));\n"
+        "    for(int i = 0; i < (int) states.size(); i++) {\n"
+        "        indices[(unsigned char) states[i]] = i;\n"
+        "    }\n"
+        "    for(int y = 0; y < height; y++) {\n"
+        "        for(int x = 0; x < width; x++) {\n"
+        "            uint8_t state = indices[(unsigned char) characters[(size_t) y * width + x]];\n"
+        "            if(state == 0xFF) {\n"
+        "                return false;\n"
+        "            }\n"
+        "            grid.set(coordinate2d({x,y}), state);\n"
+        "        }\n"
+        "    }\n"
+        "    return true;\n"
+        "}\n"
+        "template<int BITS>\n"
+        "void decode(const std::vector<char> &states, const Grid<BITS> &grid) {\n"
+        "    for(int y = 0; y < height; y++) {\n"
+        "        for(int x = 0; x < width; x++) {\n"
+        "            characters[(size_t) y * width + x] = states[grid[coordinate2d({x,y})]];\n"
+        "        }\n"
+        "    }\n"
+        "}\n"
         ;
 
     std::string neighbourhoods_gen;
@@ -312,6 +1889,7 @@ std::string ast::Program::codegen() {
     }
 
     std::string models_gen;
+    std::vector<std::string> model_units;
     for(auto model : models) {
         auto it = globals.insert({model->model_id, model});
         if(!it.second) {
@@ -323,13 +1901,1120 @@ std::string ast::Program::codegen() {
             return "";
         }
         models_gen = models_gen + code;
+        model_units.push_back(code);
     }
     
-    std::string main_a =
+    if(options.sharding) {
+        // Shards each own a band of rows, exchanging the rows bordering them every generation.
+        runtime = runtime +
+            linkage() + "int shard = 0;\n"
+            + linkage() + "int shards = 1;\n"
+            + linkage() + "int launch = 0;\n"
+            + linkage() + "std::string session;\n" +
+            "// Seconds a shard waits on its neighbours before giving up, or 0 to wait as long as they take.\n"
+            + linkage() + "int shard_timeout = 0;\n" +
+            "// Exchanges the rows bordering each shard with the shards above and below it.\n"
+            "class Transport {\n"
+            "  public:\n"
+            "    virtual ~Transport() {};\n"
+            "    // Connects to the neighbouring shards.\n"
+            "    virtual bool open() = 0;\n"
+            "    // Publishes the shard\'s first and last rows of generation t, then receives its neighbours\' into the halos.\n"
+            "    virtual bool exchange(int t, const uint8_t *first, const uint8_t *last, uint8_t *above, uint8_t *below) = 0;\n"
+            "};\n"
+            "// Transport through a POSIX shared memory segment, for shards on one machine.\n"
+            "class SharedMemory : public Transport {\n"
+            "    static const int LINE = 64;\n"
+            "    std::string name;\n"
+            "    int shard, shards;\n"
+            "    size_t bytes, slot_size, size;\n"
+            "    uint8_t *base = nullptr;\n"
+            "    // Set once this shard gives up on the others, which may never finish to remove the segment.\n"
+            "    bool failed = false;\n"
+            "    std::atomic<int> &counter(int offset) {\n"
+            "        return *reinterpret_cast<std::atomic<int>*>(base + offset);\n"
+            "    }\n"
+            "    // Generations published by each shard, followed by its rows for even and odd generations.\n"
+            "    std::atomic<int> &published(int s) {\n"
+            "        return counter(LINE + s * slot_size);\n"
+            "    }\n"
+            "    uint8_t *rows(int s, int parity, int edge) {\n"
+            "        return base + LINE + s * slot_size + LINE + (parity * 2 + edge) * bytes;\n"
+            "    }\n"
+            "    // Sleeps on a futex until value reaches target, or until shard_timeout passes if set.\n"
+            "    bool await(std::atomic<int> &value, int target) {\n"
+            "        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(shard_timeout);\n"
+            "        int seen;\n"
+            "        while((seen = value.load(std::memory_order_acquire)) < target) {\n"
+            "            timespec left = {0, 0};\n"
+            "            if(shard_timeout > 0) {\n"
+            "                auto remaining = deadline - std::chrono::steady_clock::now();\n"
+            "                if(remaining <= std::chrono::steady_clock::duration::zero()) {\n"
+            "                    return false;\n"
+            "                }\n"
+            "                left.tv_sec = remaining / std::chrono::seconds(1);\n"
+            "                left.tv_nsec = (remaining % std::chrono::seconds(1)) / std::chrono::nanoseconds(1);\n"
+            "            }\n"
+            "            // Shards are separate processes, so the futex is not private.\n"
+            "            syscall(SYS_futex, &value, FUTEX_WAIT, seen, shard_timeout > 0 ? &left : nullptr, nullptr, 0);\n"
+            "        }\n"
+            "        return true;\n"
+            "    }\n"
+            "    void wake(std::atomic<int> &value) {\n"
+            "        syscall(SYS_futex, &value, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);\n"
+            "    }\n"
+            "  public:\n"
+            "    SharedMemory(const std::string &name, int shard, int shards, size_t bytes)\n"
+            "      : name(name), shard(shard), shards(shards), bytes(bytes) {\n"
+            "        slot_size = ((LINE + 4 * bytes + LINE - 1) / LINE) * LINE;\n"
+            "        size = LINE + shards * slot_size;\n"
+            "    };\n"
+            "    // Maps the segment, waiting for every shard to attach.\n"
+            "    bool open() {\n"
+            "        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);\n"
+            "        if(fd < 0) {\n"
+            "            return false;\n"
+            "        }\n"
+            "        failed = true;\n"
+            "        void *memory = ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;\n"
+            "        close(fd);\n"
+            "        if(memory == MAP_FAILED) {\n"
+            "            return false;\n"
+            "        }\n"
+            "        base = (uint8_t *) memory;\n"
+            "        counter(0).fetch_add(1);\n"
+            "        wake(counter(0));\n"
+            "        if(!await(counter(0), shards)) {\n"
+            "            return false;\n"
+            "        }\n"
+            "        failed = false;\n"
+            "        return true;\n"
+            "    }\n"
+            "    ~SharedMemory() {\n"
+            "        // The last shard to finish removes the segment, as does any shard which failed.\n"
+            "        bool last = base && counter(sizeof(int)).fetch_add(1) == shards - 1;\n"
+            "        if(last || failed) {\n"
+            "            shm_unlink(name.c_str());\n"
+            "        }\n"
+            "        if(base) {\n"
+            "            munmap(base, size);\n"
+            "        }\n"
+            "    }\n"
+            "    // Rows are double buffered, as a neighbour may still read the previous generation\'s.\n"
+            "    bool exchange(int t, const uint8_t *first, const uint8_t *last, uint8_t *above, uint8_t *below) {\n"
+            "        int parity = t % 2;\n"
+            "        memcpy(rows(shard, parity, 0), first, bytes);\n"
+            "        memcpy(rows(shard, parity, 1), last, bytes);\n"
+            "        published(shard).store(t + 1, std::memory_order_release);\n"
+            "        wake(published(shard));\n"
+            "        int up = (shard + shards - 1) % shards;\n"
+            "        int down = (shard + 1) % shards;\n"
+            "        if(!await(published(up), t + 1) || !await(published(down), t + 1)) {\n"
+            "            failed = true;\n"
+            "            return false;\n"
+            "        }\n"
+            "        memcpy(above, rows(up, parity, 1), bytes);\n"
+            "        memcpy(below, rows(down, parity, 0), bytes);\n"
+            "        return true;\n"
+            "    }\n"
+            "};\n"
+            "// Simulates this shard\'s band of rows, exchanging halos as deep as the radius, and writes the band to OUTPUT.\n"
+            "template<typename Rule>\n"
+            "const char* runShard(const std::vector<char> &states, int r, Rule rule) {\n"
+            "    if(depth > 1) {\n"
+            "        return \"Error: Expected 2 Dimensions for INPUT.\";\n"
+            "    }\n"
+            "    if(height / shards < r) {\n"
+            "        return \"Error: Too many SHARDS for the height of INPUT.\";\n"
+            "    }\n"
+            "    uint8_t indices[256];\n"
+            "    memset(indices, 0xFF, sizeof(indices));\n"
+            "    for(int i = 0; i < (int) states.size(); i++) {\n"
+            "        indices[(unsigned char) states[i]] = i;\n"
+            "    }\n"
+            "    int begin = height * shard / shards;\n"
+            "    int rows = height * (shard + 1) / shards - begin;\n"
+            "    int stride = width + 2 * r;\n"
+            "    std::vector<uint8_t> prev((size_t) (rows + 2 * r) * stride);\n"
+            "    std::vector<uint8_t> next(prev.size());\n"
+            "    // Each shard reads only its own band of INPUT. Rows are as long as the first, line ending\n"
+            "    // included, so the band starts at a known offset.\n"
+            "    FILE *input = fopen(input_name.c_str(), \"rb\");\n"
+            "    if(input == NULL) {\n"
+            "        return \"Error: Unable to open INPUT.\";\n"
+            "    }\n"
+            "    size_t line = 1;\n"
+            "    int c;\n"
+            "    while((c = getc(input)) != \'\\n\' && c != EOF) {\n"
+            "        line++;\n"
+            "    }\n"
+            "    std::vector<char> text(line);\n"
+            "    bool read = fseeko(input, (off_t) begin * line, SEEK_SET) == 0;\n"
+            "    for(int y = 0; y < rows && read; y++) {\n"
+            "        size_t n = fread(text.data(), 1, line, input);\n"
+            "        // Only the last row may end without a newline.\n"
+            "        read = (n == line && text[line - 1] == \'\\n\') || (begin + y == height - 1 && n == line - 1);\n"
+            "        for(int x = 0; x < width && read; x++) {\n"
+            "            uint8_t state = indices[(unsigned char) text[x]];\n"
+            "            if(state == 0xFF) {\n"
+            "                fclose(input);\n"
+            "                return \"Error: Unrecognised state within INPUT.\";\n"
+            "            }\n"
+            "            prev[(size_t) (y + r) * stride + x + r] = state;\n"
+            "        }\n"
+            "    }\n"
+            "    fclose(input);\n"
+            "    if(!read) {\n"
+            "        return \"Error: Rows of a sharded INPUT must have the same line endings.\";\n"
+            "    }\n"
+            "    std::unique_ptr<Transport> transport(new SharedMemory(session, shard, shards, (size_t) r * stride));\n"
+            "    if(!transport->open()) {\n"
+            "        return \"Error: Unable to attach to the shared memory of SESSION.\";\n"
+            "    }\n"
+            "    for(int t = 0; t < steps; t++) {\n"
+            "        if(!transport->exchange(t, &prev[(size_t) r * stride], &prev[(size_t) rows * stride], &prev[0], &prev[(size_t) (rows + r) * stride])) {\n"
+            "            return \"Error: Timed out waiting for neighbouring shards.\";\n"
+            "        }\n"
+            "        for(int y = 0; y < rows + 2 * r; y++) {\n"
+            "            uint8_t *row = &prev[(size_t) y * stride];\n"
+            "            for(int i = 0; i < r; i++) {\n"
+            "                row[i] = row[width + i];\n"
+            "                row[width + r + i] = row[r + i];\n"
+            "            }\n"
+            "        }\n"
+            "        for(int y = r; y < rows + r; y++) {\n"
+            "            for(int x = r; x < width + r; x++) {\n"
+            "                int64_t current = (int64_t) y * stride + x;\n"
+            "                next[current] = rule(Local{prev.data(), stride, 0, current}, Dice{t, x - r, begin + y - r, 0});\n"
+            "            }\n"
+            "        }\n"
+            "        std::swap(next, prev);\n"
+            "    }\n"
+            "    // Shards write their rows straight into OUTPUT, which every shard sizes the same.\n"
+            "    int fd = open(output_name.c_str(), O_WRONLY | O_CREAT, 0644);\n"
+            "    if(fd < 0 || ftruncate(fd, (off_t) height * (width + 1)) != 0) {\n"
+            "        return \"Error: Unable to open OUTPUT.\";\n"
+            "    }\n"
+            "    line = (size_t) width + 1;\n"
+            "    text.assign(rows * line, 0);\n"
+            "    for(int y = 0; y < rows; y++) {\n"
+            "        for(int x = 0; x < width; x++) {\n"
+            "            text[y * line + x] = states[prev[(size_t) (y + r) * stride + x + r]];\n"
+            "        }\n"
+            "        text[y * line + width] = \'\\n\';\n"
+            "    }\n"
+            "    bool written = pwrite(fd, text.data(), text.size(), (off_t) begin * line) == (ssize_t) text.size();\n"
+            "    close(fd);\n"
+            "    return written ? \"\" : \"Error: Unable to write OUTPUT.\";\n"
+            "}\n";
+    }
+
+    if(options.cycles) {
+        runtime = runtime +
+            "// Hash of a cell in state s at index i; a grid\'s hash is the sum over its cells, in any order.\n"
+            "inline uint64_t cellHash(uint64_t i, uint8_t s) {\n"
+            "    uint64_t h = ((i << 8) | s) * 0x9E3779B97F4A7C15ULL;\n"
+            "    return h ^ (h >> 29);\n"
+            "}\n"
+            "// Detects when the grid repeats a generation, from the hash of each generation.\n"
+            "class Cycles {\n"
+            "    static const size_t REMEMBERED = 1 << 20;\n"
+            "    std::unordered_map<uint64_t, int> seen;\n"
+            "    std::vector<uint8_t> candidate;\n"
+            "    int candidate_t = 0;\n"
+            "    int period = 0;\n"
+            "  public:\n"
+            "    // Returns the period once the cells of generation t are known to repeat, otherwise 0.\n"
+            "    int observe(int t, uint64_t hash, const std::vector<uint8_t> &cells) {\n"
+            "        if(period > 0) {\n"
+            "            if(t < candidate_t + period) {\n"
+            "                return 0;\n"
+            "            }\n"
+            "            // A repeated hash is only trusted once the cells themselves repeat.\n"
+            "            int repeated = period;\n"
+            "            period = 0;\n"
+            "            if(cells == candidate) {\n"
+            "                return repeated;\n"
+            "            }\n"
+            "        }\n"
+            "        auto it = seen.find(hash);\n"
+            "        if(it != seen.end()) {\n"
+            "            period = t - it->second;\n"
+            "            candidate = cells;\n"
+            "            candidate_t = t;\n"
+            "        } else if(seen.size() >= REMEMBERED) {\n"
+            "            seen.clear();\n"
+            "        }\n"
+            "        seen[hash] = t;\n"
+            "        return 0;\n"
+            "    }\n"
+            "};\n";
+    }
+
+    if(options.statistics) {
+        runtime = runtime +
+            linkage() + "std::string stats_name;\n"
+            "// Counts of the cells in each state, and the bounds of those not in the background state.\n"
+            "struct Tally {\n"
+            "    std::array<uint64_t, 256> counts = {};\n"
+            "    int64_t low[3] = {INT64_MAX, INT64_MAX, INT64_MAX};\n"
+            "    int64_t high[3] = {INT64_MIN, INT64_MIN, INT64_MIN};\n"
+            "    void add(int64_t x, int64_t y, int64_t z, uint8_t state, uint8_t background) {\n"
+            "        counts[state]++;\n"
+            "        if(state != background) {\n"
+            "            low[0] = std::min(low[0], x);\n"
+            "            high[0] = std::max(high[0], x);\n"
+            "            low[1] = std::min(low[1], y);\n"
+            "            high[1] = std::max(high[1], y);\n"
+            "            low[2] = std::min(low[2], z);\n"
+            "            high[2] = std::max(high[2], z);\n"
+            "        }\n"
+            "    }\n"
+            "    void merge(const Tally &other) {\n"
+            "        for(int i = 0; i < 256; i++) {\n"
+            "            counts[i] += other.counts[i];\n"
+            "        }\n"
+            "        for(int i = 0; i < 3; i++) {\n"
+            "            low[i] = std::min(low[i], other.low[i]);\n"
+            "            high[i] = std::max(high[i], other.high[i]);\n"
+            "        }\n"
+            "    }\n"
+            "};\n"
+            "// Writes a row of statistics per generation into STATS, as CSV if it ends in .csv, otherwise as\n"
+            "// EMGSTAT1, the number of states and dimensions (int32) then per generation an int64 generation,\n"
+            "// a uint64 count per state and an int64 low and high bound per dimension (INT64_MAX, INT64_MIN if none).\n"
+            "class Statistics {\n"
+            "    FILE *file = NULL;\n"
+            "    bool csv = false;\n"
+            "    int32_t states = 0, dimensions = 0;\n"
+            "  public:\n"
+            "    bool open(const std::string &names, int32_t states, int32_t dimensions) {\n"
+            "        if(stats_name == \"\") {\n"
+            "            return true;\n"
+            "        }\n"
+            "        this->states = states;\n"
+            "        this->dimensions = dimensions;\n"
+            "        csv = stats_name.size() >= 4 && stats_name.compare(stats_name.size() - 4, 4, \".csv\") == 0;\n"
+            "        file = fopen(stats_name.c_str(), \"wb\");\n"
+            "        if(file == NULL) {\n"
+            "            return false;\n"
+            "        }\n"
+            "        if(csv) {\n"
+            "            fprintf(file, \"generation,%s\", names.c_str());\n"
+            "            for(int i = 0; i < dimensions; i++) {\n"
+            "                fprintf(file, \",min_%c,max_%c\", \"xyz\"[i], \"xyz\"[i]);\n"
+            "            }\n"
+            "            return fputc(\'\\n\', file) != EOF;\n"
+            "        }\n"
+            "        return fwrite(\"EMGSTAT1\", 8, 1, file) == 1 &&\n"
+            "            fwrite(&states, sizeof(states), 1, file) == 1 &&\n"
+            "            fwrite(&dimensions, sizeof(dimensions), 1, file) == 1;\n"
+            "    }\n"
+            "    bool active() const {\n"
+            "        return file != NULL;\n"
+            "    }\n"
+            "    bool write(int64_t generation, const Tally &tally) {\n"
+            "        if(!csv) {\n"
+            "            bool written = fwrite(&generation, sizeof(generation), 1, file) == 1 &&\n"
+            "                fwrite(tally.counts.data(), sizeof(uint64_t), states, file) == (size_t) states;\n"
+            "            for(int i = 0; i < dimensions; i++) {\n"
+            "                written = written && fwrite(&tally.low[i], sizeof(int64_t), 1, file) == 1 &&\n"
+            "                    fwrite(&tally.high[i], sizeof(int64_t), 1, file) == 1;\n"
+            "            }\n"
+            "            return written;\n"
+            "        }\n"
+            "        fprintf(file, \"%lld\", (long long) generation);\n"
+            "        for(int i = 0; i < states; i++) {\n"
+            "            fprintf(file, \",%llu\", (unsigned long long) tally.counts[i]);\n"
+            "        }\n"
+            "        for(int i = 0; i < dimensions; i++) {\n"
+            "            if(tally.low[i] <= tally.high[i]) {\n"
+            "                fprintf(file, \",%lld,%lld\", (long long) tally.low[i], (long long) tally.high[i]);\n"
+            "            } else {\n"
+            "                fputs(\",,\", file);\n"
+            "            }\n"
+            "        }\n"
+            "        return fputc(\'\\n\', file) != EOF;\n"
+            "    }\n"
+            "    bool close() {\n"
+            "        if(file == NULL) {\n"
+            "            return true;\n"
+            "        }\n"
+            "        bool closed = !ferror(file);\n"
+            "        closed = fclose(file) == 0 && closed;\n"
+            "        file = NULL;\n"
+            "        return closed;\n"
+            "    }\n"
+            "};\n";
+    }
+
+    if(options.streaming) {
+        runtime = runtime +
+            "// Grids too large for memory are kept as files of a byte per cell within SCRATCH,\n"
+            "// and streamed through memory a band of rows at a time.\n"
+            + linkage() + "std::string scratch;\n"
+            "const size_t BAND_BYTES = 32 << 20;\n"
+            "// A band of rows with a halo deep enough to advance it several generations.\n"
+            "struct Band {\n"
+            "    int begin = 0, rows = 0;\n"
+            "    std::vector<uint8_t> a, b;\n"
+            "};\n"
+            "// Reads rows [begin - halo, begin + rows + halo) of the grid in fd, wrapping around its edges.\n"
+            + linkage() + "bool loadBand(int fd, Band &band, int halo) {\n"
+            "    int w = width + 2 * halo;\n"
+            "    band.a.resize((size_t) w * (band.rows + 2 * halo));\n"
+            "    band.b.resize(band.a.size());\n"
+            "    for(int ly = 0; ly < band.rows + 2 * halo; ly++) {\n"
+            "        uint8_t *row = &band.a[(size_t) ly * w];\n"
+            "        off_t y = wrap(band.begin + ly - halo, height);\n"
+            "        if(pread(fd, row + halo, width, y * width) != width) {\n"
+            "            return false;\n"
+            "        }\n"
+            "        for(int lx = 0; lx < halo; lx++) {\n"
+            "            row[lx] = row[halo + wrap(lx - halo, width)];\n"
+            "            row[halo + width + lx] = row[halo + wrap(lx, width)];\n"
+            "        }\n"
+            "    }\n"
+            "    return true;\n"
+            "}\n"
+            "// Writes the rows of the band, less its halo, into the grid in fd.\n"
+            + linkage() + "bool storeBand(int fd, const Band &band, int halo) {\n"
+            "    int w = width + 2 * halo;\n"
+            "    for(int ly = 0; ly < band.rows; ly++) {\n"
+            "        off_t y = band.begin + ly;\n"
+            "        if(pwrite(fd, &band.a[(size_t) (ly + halo) * w + halo], width, y * width) != width) {\n"
+            "            return false;\n"
+            "        }\n"
+            "    }\n"
+            "    return true;\n"
+            "}\n"
+            "template<typename Rule>\n"
+            "const char* runStreamed(const std::vector<char> &states, int r, Rule rule) {\n"
+            "    uint8_t indices[256];\n"
+            "    memset(indices, 0xFF, sizeof(indices));\n"
+            "    for(int i = 0; i < (int) states.size(); i++) {\n"
+            "        indices[(unsigned char) states[i]] = i;\n"
+            "    }\n"
+            "    std::string prefix = scratch + \"/emergent_\" + std::to_string(getpid());\n"
+            "    int prev = ::open((prefix + \"_a\").c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);\n"
+            "    int next = ::open((prefix + \"_b\").c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);\n"
+            "    unlink((prefix + \"_a\").c_str());\n"
+            "    unlink((prefix + \"_b\").c_str());\n"
+            "    if(prev < 0 || next < 0) {\n"
+            "        return \"Error: Unable to create files within SCRATCH.\";\n"
+            "    }\n"
+            "    // INPUT is translated into indices a row at a time.\n"
+            "    FILE *input = fopen(input_name.c_str(), \"r\");\n"
+            "    std::vector<uint8_t> row(width);\n"
+            "    int y = 0;\n"
+            "    int x = 0;\n"
+            "    int c;\n"
+            "    while((c = getc(input)) != EOF && y < height) {\n"
+            "        if(c == \'\\r\' || (c == \'\\n\' && x == 0)) {\n"
+            "            continue;\n"
+            "        }\n"
+            "        if(c == \'\\n\') {\n"
+            "            if(pwrite(prev, row.data(), width, (off_t) y * width) != width) {\n"
+            "                fclose(input);\n"
+            "                return \"Error: Unable to write within SCRATCH.\";\n"
+            "            }\n"
+            "            y++;\n"
+            "            x = 0;\n"
+            "            continue;\n"
+            "        }\n"
+            "        if((row[x++] = indices[c]) == 0xFF) {\n"
+            "            fclose(input);\n"
+            "            return \"Error: Unrecognised state within INPUT.\";\n"
+            "        }\n"
+            "    }\n"
+            "    fclose(input);\n"
+            "    if(y < height && pwrite(prev, row.data(), width, (off_t) y * width) != width) {\n"
+            "        return \"Error: Unable to write within SCRATCH.\";\n"
+            "    }\n"
+            "    int rows = std::max<int>(1, std::min<size_t>(height, BAND_BYTES / width));\n"
+            "    int block = std::max(1, std::min(16, rows / (4 * r)));\n"
+            "    for(int t = 0; t < steps; t += block) {\n"
+            "        int generations = std::min(block, steps - t);\n"
+            "        int halo = generations * r;\n"
+            "        // While one band is advanced, the next is read and the last written on other threads.\n"
+            "        Band bands[3];\n"
+            "        std::thread reader, writer;\n"
+            "        bool read = true, written = true;\n"
+            "        auto load = [&](Band &band, int begin) {\n"
+            "            band.begin = begin;\n"
+            "            band.rows = std::min(rows, height - begin);\n"
+            "            read = loadBand(prev, band, halo);\n"
+            "        };\n"
+            "        load(bands[0], 0);\n"
+            "        for(int i = 0, begin = 0; begin < height; i++, begin += rows) {\n"
+            "            Band &band = bands[i % 3];\n"
+            "            if(begin + rows < height) {\n"
+            "                reader = spawn([&, i, begin]() {\n"
+            "                    load(bands[(i + 1) % 3], begin + rows);\n"
+            "                });\n"
+            "            }\n"
+            "            int w = width + 2 * halo;\n"
+            "            int h = band.rows + 2 * halo;\n"
+            "            for(int s = 1; s <= generations; s++) {\n"
+            "                int sr = s * r;\n"
+            "                for(int ly = sr; ly < h - sr; ly++) {\n"
+            "                    for(int lx = sr; lx < w - sr; lx++) {\n"
+            "                        int current = ly * w + lx;\n"
+            "                        band.b[current] = rule(Local{band.a.data(), w, 0, current},\n"
+            "                            Dice{t + s - 1, wrap(lx - halo, width), wrap(band.begin + ly - halo, height), 0});\n"
+            "                    }\n"
+            "                }\n"
+            "                std::swap(band.a, band.b);\n"
+            "            }\n"
+            "            if(writer.joinable()) {\n"
+            "                writer.join();\n"
+            "            }\n"
+            "            writer = spawn([&, i]() {\n"
+            "                written = storeBand(next, bands[i % 3], halo) && written;\n"
+            "            });\n"
+            "            if(reader.joinable()) {\n"
+            "                reader.join();\n"
+            "            }\n"
+            "            if(!read) {\n"
+            "                break;\n"
+            "            }\n"
+            "        }\n"
+            "        if(writer.joinable()) {\n"
+            "            writer.join();\n"
+            "        }\n"
+            "        if(!read || !written) {\n"
+            "            return \"Error: Unable to stream the grid through SCRATCH.\";\n"
+            "        }\n"
+            "        std::swap(prev, next);\n"
+            "    }\n"
+            "    // OUTPUT is written a row at a time.\n"
+            "    FILE *output = fopen(output_name.c_str(), \"w\");\n"
+            "    if(output == NULL) {\n"
+            "        return \"Error: Unable to open OUTPUT.\";\n"
+            "    }\n"
+            "    std::vector<char> text(width + 1);\n"
+            "    text[width] = \'\\n\';\n"
+            "    for(int y = 0; y < height; y++) {\n"
+            "        if(pread(prev, row.data(), width, (off_t) y * width) != width) {\n"
+            "            fclose(output);\n"
+            "            return \"Error: Unable to read within SCRATCH.\";\n"
+            "        }\n"
+            "        for(int x = 0; x < width; x++) {\n"
+            "            text[x] = states[row[x]];\n"
+            "        }\n"
+            "        fwrite(text.data(), 1, text.size(), output);\n"
+            "    }\n"
+            "    close(prev);\n"
+            "    close(next);\n"
+            "    return fclose(output) == 0 ? \"\" : \"Error: Unable to write OUTPUT.\";\n"
+            "}\n";
+    }
+
+    if(options.unbounded) {
+        runtime = runtime +
+            "// Unbounded grids are kept as chunks in a hash map, absent wherever every cell is in the default state.\n"
+            + linkage() + "bool unbounded = false;\n"
+            "const int CHUNK = 64;\n"
+            "struct Chunk {\n"
+            "    uint8_t cells[CHUNK * CHUNK];\n"
+            "};\n"
+            + linkage() + "uint64_t chunkKey(int cx, int cy) {\n"
+            "    return (uint64_t) (uint32_t) cx << 32 | (uint32_t) cy;\n"
+            "}\n"
+            "// Where the part of a neighbouring chunk d, within the halo of a chunk, lies in each.\n"
+            + linkage() + "void chunkSpan(int d, int r, int &local, int &length, int &source) {\n"
+            "    local = d < 0 ? 0 : d == 0 ? r : r + CHUNK;\n"
+            "    length = d == 0 ? CHUNK : r;\n"
+            "    source = d < 0 ? CHUNK - r : 0;\n"
+            "}\n"
+            "template<typename Rule>\n"
+            "const char* runUnbounded(const std::vector<char> &states, uint8_t background, int r, Rule rule) {\n"
+            "    if(r > CHUNK) {\n"
+            "        return \"Error: The neighbourhood is too wide for unbounded grids.\";\n"
+            "    }\n"
+            "    std::vector<uint8_t> blank((2 * r + 1) * (2 * r + 1), background);\n"
+            "    // Rules drawing random numbers amid the default state are rejected when compiled, so one test suffices.\n"
+            "    if(rule(Local{blank.data(), 2 * r + 1, 0, r * (2 * r + 1) + r}, Dice{0, 0, 0, 0}) != background) {\n"
+            "        return \"Error: Unbounded grids need the default state to stay amid the default state.\";\n"
+            "    }\n"
+            "    typedef std::unordered_map<uint64_t, std::unique_ptr<Chunk>> Chunks;\n"
+            "    Chunks prev;\n"
+            "    std::vector<std::unique_ptr<Chunk>> spare;\n"
+            "    std::mutex spare_lock;\n"
+            "    auto allocate = [&]() {\n"
+            "        std::lock_guard<std::mutex> guard(spare_lock);\n"
+            "        if(spare.empty()) {\n"
+            "            return std::unique_ptr<Chunk>(new Chunk);\n"
+            "        }\n"
+            "        std::unique_ptr<Chunk> chunk = std::move(spare.back());\n"
+            "        spare.pop_back();\n"
+            "        return chunk;\n"
+            "    };\n"
+            "    uint8_t indices[256];\n"
+            "    memset(indices, 0xFF, sizeof(indices));\n"
+            "    for(int i = 0; i < (int) states.size(); i++) {\n"
+            "        indices[(unsigned char) states[i]] = i;\n"
+            "    }\n"
+            "    for(int y = 0; y < height; y++) {\n"
+            "        for(int x = 0; x < width; x++) {\n"
+            "            uint8_t state = indices[(unsigned char) characters[y * width + x]];\n"
+            "            if(state == 0xFF) {\n"
+            "                return \"Error: Unrecognised state within INPUT.\";\n"
+            "            }\n"
+            "            if(state == background) {\n"
+            "                continue;\n"
+            "            }\n"
+            "            std::unique_ptr<Chunk> &chunk = prev[chunkKey(x / CHUNK, y / CHUNK)];\n"
+            "            if(!chunk) {\n"
+            "                chunk = allocate();\n"
+            "                memset(chunk->cells, background, sizeof(chunk->cells));\n"
+            "            }\n"
+            "            chunk->cells[(y % CHUNK) * CHUNK + x % CHUNK] = state;\n"
+            "        }\n"
+            "    }\n"
+            "    int stride = CHUNK + 2 * r;\n"
+            "    for(int t = 0; t < steps; t++) {\n"
+            "        // Chunks beside those in use are the frontier the grid may grow into.\n"
+            "        std::vector<std::pair<int,int>> candidates;\n"
+            "        std::unordered_set<uint64_t> considered;\n"
+            "        for(auto &entry : prev) {\n"
+            "            int cx = (int) (entry.first >> 32);\n"
+            "            int cy = (int) (uint32_t) entry.first;\n"
+            "            for(int dy = -1; dy <= 1; dy++) {\n"
+            "                for(int dx = -1; dx <= 1; dx++) {\n"
+            "                    if(considered.insert(chunkKey(cx + dx, cy + dy)).second) {\n"
+            "                        candidates.push_back({cx + dx, cy + dy});\n"
+            "                    }\n"
+            "                }\n"
+            "            }\n"
+            "        }\n"
+            "        std::vector<std::unique_ptr<Chunk>> results(candidates.size());\n"
+            "        parallel(candidates.size(), [&](int begin, int end) {\n"
+            "            std::vector<uint8_t> padded(stride * stride);\n"
+            "            Chunk result;\n"
+            "            for(int i = begin; i < end; i++) {\n"
+            "                for(int dy = -1; dy <= 1; dy++) {\n"
+            "                    for(int dx = -1; dx <= 1; dx++) {\n"
+            "                        auto it = prev.find(chunkKey(candidates[i].first + dx, candidates[i].second + dy));\n"
+            "                        const Chunk *around = it == prev.end() ? nullptr : it->second.get();\n"
+            "                        int lx, width_x, sx, ly, height_y, sy;\n"
+            "                        chunkSpan(dx, r, lx, width_x, sx);\n"
+            "                        chunkSpan(dy, r, ly, height_y, sy);\n"
+            "                        for(int y = 0; y < height_y; y++) {\n"
+            "                            uint8_t *row = &padded[(ly + y) * stride + lx];\n"
+            "                            if(around) {\n"
+            "                                memcpy(row, &around->cells[(sy + y) * CHUNK + sx], width_x);\n"
+            "                            } else {\n"
+            "                                memset(row, background, width_x);\n"
+            "                            }\n"
+            "                        }\n"
+            "                    }\n"
+            "                }\n"
+            "                bool active = false;\n"
+            "                for(int y = 0; y < CHUNK; y++) {\n"
+            "                    for(int x = 0; x < CHUNK; x++) {\n"
+            "                        uint8_t state = rule(Local{padded.data(), stride, 0, (y + r) * stride + x + r},\n"
+            "                            Dice{t, (int64_t) candidates[i].first * CHUNK + x, (int64_t) candidates[i].second * CHUNK + y, 0});\n"
+            "                        result.cells[y * CHUNK + x] = state;\n"
+            "                        active = active || state != background;\n"
+            "                    }\n"
+            "                }\n"
+            "                if(active) {\n"
+            "                    results[i] = allocate();\n"
+            "                    *results[i] = result;\n"
+            "                }\n"
+            "            }\n"
+            "        });\n"
+            "        // Chunks which are all in the default state are freed.\n"
+            "        for(auto &entry : prev) {\n"
+            "            spare.push_back(std::move(entry.second));\n"
+            "        }\n"
+            "        prev.clear();\n"
+            "        for(int i = 0; i < (int) candidates.size(); i++) {\n"
+            "            if(results[i]) {\n"
+            "                prev[chunkKey(candidates[i].first, candidates[i].second)] = std::move(results[i]);\n"
+            "            }\n"
+            "        }\n"
+            "    }\n"
+            "    // OUTPUT covers INPUT and every cell which has left the default state.\n"
+            "    int left = 0, top = 0, right = width, bottom = height;\n"
+            "    for(auto &entry : prev) {\n"
+            "        int cx = (int) (entry.first >> 32);\n"
+            "        int cy = (int) (uint32_t) entry.first;\n"
+            "        for(int y = 0; y < CHUNK; y++) {\n"
+            "            for(int x = 0; x < CHUNK; x++) {\n"
+            "                if(entry.second->cells[y * CHUNK + x] != background) {\n"
+            "                    left = std::min(left, cx * CHUNK + x);\n"
+            "                    right = std::max(right, cx * CHUNK + x + 1);\n"
+            "                    top = std::min(top, cy * CHUNK + y);\n"
+            "                    bottom = std::max(bottom, cy * CHUNK + y + 1);\n"
+            "                }\n"
+            "            }\n"
+            "        }\n"
+            "    }\n"
+            "    width = right - left;\n"
+            "    height = bottom - top;\n"
+            "    characters.assign((size_t) width * height, states[background]);\n"
+            "    for(auto &entry : prev) {\n"
+            "        int cx = (int) (entry.first >> 32);\n"
+            "        int cy = (int) (uint32_t) entry.first;\n"
+            "        for(int y = 0; y < CHUNK; y++) {\n"
+            "            for(int x = 0; x < CHUNK; x++) {\n"
+            "                uint8_t state = entry.second->cells[y * CHUNK + x];\n"
+            "                if(state != background) {\n"
+            "                    characters[(size_t) (cy * CHUNK + y - top) * width + cx * CHUNK + x - left] = states[state];\n"
+            "                }\n"
+            "            }\n"
+            "        }\n"
+            "    }\n"
+            "    return \"\";\n"
+            "}\n";
+    }
+
+    if(options.ensemble) {
+        runtime = runtime +
+            "// Ensembles simulate each layer of INPUT as an independent instance, interleaving LANES instances\n"
+            "// so that each lane of a cell holds that cell of a different instance, and a vector of LANES bytes\n"
+            "// advances every instance of the cell at once.\n"
+            + linkage() + "bool ensemble = false;\n"
+            "const int LANES = 16;\n"
+            "// Reads the cells of one lane relative to current, within a padded grid of interleaved lanes.\n"
+            "struct Lanes {\n"
+            "    const uint8_t *cells;\n"
+            "    int stride;\n"
+            "    size_t current;\n"
+            "    uint8_t centre() const {\n"
+            "        return cells[current];\n"
+            "    }\n"
+            "    uint8_t operator()(int dx) const {\n"
+            "        return cells[current + dx * LANES];\n"
+            "    }\n"
+            "    uint8_t operator()(int dx, int dy) const {\n"
+            "        return cells[current + (dy * stride + dx) * LANES];\n"
+            "    }\n"
+            "};\n"
+            "// Copies the cells opposite each edge into the halo, rx cells wide and ry cells deep.\n"
+            + linkage() + "void wrapLanes(std::vector<uint8_t> &grid, int rx, int ry) {\n"
+            "    int stride = width + 2 * rx;\n"
+            "    for(int y = ry; y < height + ry; y++) {\n"
+            "        uint8_t *row = &grid[(size_t) y * stride * LANES];\n"
+            "        for(int i = 0; i < rx; i++) {\n"
+            "            memcpy(&row[i * LANES], &row[(width + i) * LANES], LANES);\n"
+            "            memcpy(&row[(width + rx + i) * LANES], &row[(rx + i) * LANES], LANES);\n"
+            "        }\n"
+            "    }\n"
+            "    for(int i = 0; i < ry; i++) {\n"
+            "        memcpy(&grid[(size_t) i * stride * LANES], &grid[(size_t) (height + i) * stride * LANES], stride * LANES);\n"
+            "        memcpy(&grid[(size_t) (height + ry + i) * stride * LANES], &grid[(size_t) (ry + i) * stride * LANES], stride * LANES);\n"
+            "    }\n"
+            "}\n"
+            "// Counts the offsets in list for which f holds, as a sum unrolled at compile time, so no branch is left.\n"
+            "template<size_t N>\n"
+            "struct Unrolled {\n"
+            "    template<typename List, typename F>\n"
+            "    static int count(const List &list, F f) {\n"
+            "        return Unrolled<N - 1>::count(list, f) + (int) (bool) f(list[N - 1]);\n"
+            "    }\n"
+            "};\n"
+            "template<>\n"
+            "struct Unrolled<0> {\n"
+            "    template<typename List, typename F>\n"
+            "    static int count(const List &, F) {\n"
+            "        return 0;\n"
+            "    }\n"
+            "};\n"
+            "template<typename List, typename F>\n"
+            "int countUnrolled(const List &list, F f) {\n"
+            "    return Unrolled<std::tuple_size<List>::value>::count(list, f);\n"
+            "}\n"
+            "// Advances the LANES instances of the cell at current. The rule given is branch-free, and the lanes\n"
+            "// are passed by pointer and value alone, so that the loop is vectorised.\n"
+            "template<typename Rule>\n"
+            "void advanceLanes(uint8_t *to, const uint8_t *from, int stride, size_t current, Dice dice, Rule rule) {\n"
+            "    for(int lane = 0; lane < LANES; lane++) {\n"
+            "        to[current + lane] = rule(Lanes{from + lane, stride, current}, Dice{dice.t, dice.x, dice.y, dice.z + lane});\n"
+            "    }\n"
+            "}\n"
+            "template<typename Rule>\n"
+            "const char* runEnsemble(const std::vector<char> &states, int rx, int ry, Rule rule) {\n"
+            "    uint8_t indices[256];\n"
+            "    memset(indices, 0xFF, sizeof(indices));\n"
+            "    for(int i = 0; i < (int) states.size(); i++) {\n"
+            "        indices[(unsigned char) states[i]] = i;\n"
+            "    }\n"
+            "    int stride = width + 2 * rx;\n"
+            "    size_t cells = (size_t) stride * (height + 2 * ry) * LANES;\n"
+            "    std::vector<uint8_t> prev, next(cells);\n"
+            "    for(int first = 0; first < depth; first += LANES) {\n"
+            "        // Lanes beyond the last instance are left in the first state, and never written out.\n"
+            "        int count = std::min(LANES, depth - first);\n"
+            "        prev.assign(cells, 0);\n"
+            "        for(int lane = 0; lane < count; lane++) {\n"
+            "            for(int y = 0; y < height; y++) {\n"
+            "                for(int x = 0; x < width; x++) {\n"
+            "                    uint8_t state = indices[(unsigned char) characters[((size_t) (first + lane) * height + y) * width + x]];\n"
+            "                    if(state == 0xFF) {\n"
+            "                        return \"Error: Unrecognised state within INPUT.\";\n"
+            "                    }\n"
+            "                    prev[((size_t) (y + ry) * stride + x + rx) * LANES + lane] = state;\n"
+            "                }\n"
+            "            }\n"
+            "        }\n"
+            "        for(int t = 0; t < steps; t++) {\n"
+            "            wrapLanes(prev, rx, ry);\n"
+            "            const uint8_t *from = prev.data();\n"
+            "            uint8_t *to = next.data();\n"
+            "            parallel(height, [&](int begin, int end) {\n"
+            "                for(int y = begin; y < end; y++) {\n"
+            "                    for(int x = 0; x < width; x++) {\n"
+            "                        size_t current = ((size_t) (y + ry) * stride + x + rx) * LANES;\n"
+            "                        advanceLanes(to, from, stride, current, Dice{t, x, y, first}, rule);\n"
+            "                    }\n"
+            "                }\n"
+            "            });\n"
+            "            std::swap(next, prev);\n"
+            "        }\n"
+            "        for(int lane = 0; lane < count; lane++) {\n"
+            "            for(int y = 0; y < height; y++) {\n"
+            "                for(int x = 0; x < width; x++) {\n"
+            "                    characters[((size_t) (first + lane) * height + y) * width + x] = states[prev[((size_t) (y + ry) * stride + x + rx) * LANES + lane]];\n"
+            "                }\n"
+            "            }\n"
+            "        }\n"
+            "    }\n"
+            "    return \"\";\n"
+            "}\n";
+    }
+
+    if(options.batch) {
+        runtime = runtime +
+            "// Batches run the jobs of a manifest on a pool of threads, each keeping its own grid between jobs.\n"
+            "int simulate(const std::string &model);\n"
+            "struct Job {\n"
+            "    std::string input, output;\n"
+            "    int status = 0;\n"
+            "};\n"
+            "// Each thread takes jobs from the front of its own queue, then steals from the back of the others\'.\n"
+            "class Pool {\n"
+            "    struct Queue {\n"
+            "        std::mutex lock;\n"
+            "        std::deque<int> jobs;\n"
+            "    };\n"
+            "    std::vector<Queue> queues;\n"
+            "  public:\n"
+            "    Pool(int threads, int jobs) : queues(threads) {\n"
+            "        for(int i = 0; i < jobs; i++) {\n"
+            "            queues[(size_t) i * threads / jobs].jobs.push_back(i);\n"
+            "        }\n"
+            "    }\n"
+            "    bool take(int thread, int &job) {\n"
+            "        for(int i = 0; i < (int) queues.size(); i++) {\n"
+            "            Queue &queue = queues[(thread + i) % queues.size()];\n"
+            "            std::lock_guard<std::mutex> guard(queue.lock);\n"
+            "            if(!queue.jobs.empty()) {\n"
+            "                if(i == 0) {\n"
+            "                    job = queue.jobs.front();\n"
+            "                    queue.jobs.pop_front();\n"
+            "                } else {\n"
+            "                    job = queue.jobs.back();\n"
+            "                    queue.jobs.pop_back();\n"
+            "                }\n"
+            "                return true;\n"
+            "            }\n"
+            "        }\n"
+            "        return false;\n"
+            "    }\n"
+            "};\n"
+            + linkage() + "int runBatch(const std::string &manifest, const std::string &model, const std::string &summary) {\n"
+            "    // Each line of the manifest names an INPUT and an OUTPUT.\n"
+            "    std::vector<Job> jobs;\n"
+            "    FILE *file = fopen(manifest.c_str(), \"r\");\n"
+            "    if(file == NULL) {\n"
+            "        perror(\"Error: Unable to open manifest file.\\n\");\n"
+            "        return 1;\n"
+            "    }\n"
+            "    char input[4096], output[4096];\n"
+            "    while(fscanf(file, \"%4095s %4095s\", input, output) == 2) {\n"
+            "        jobs.push_back(Job());\n"
+            "        jobs.back().input = input;\n"
+            "        jobs.back().output = output;\n"
+            "    }\n"
+            "    fclose(file);\n"
+            "    if(jobs.empty()) {\n"
+            "        std::cout << \"Error: The manifest lists no jobs.\\n\";\n"
+            "        return 1;\n"
+            "    }\n"
+            "    int threads = std::min<int>(std::max(1u, std::thread::hardware_concurrency()), jobs.size());\n"
+            "    Pool pool(threads, jobs.size());\n"
+            "    std::vector<std::thread> workers;\n"
+            "    for(int i = 0; i < threads; i++) {\n"
+            "        workers.emplace_back([&, i]() {\n"
+            "            int job;\n"
+            "            while(pool.take(i, job)) {\n"
+            "                input_name = jobs[job].input;\n"
+            "                output_name = jobs[job].output;\n"
+            "                jobs[job].status = simulate(model);\n"
+            "            }\n"
+            "        });\n"
+            "    }\n"
+            "    for(auto &worker : workers) {\n"
+            "        worker.join();\n"
+            "    }\n"
+            "    // The summary records whether each job succeeded, so one failure does not hide the rest.\n"
+            "    FILE *out = fopen(summary.c_str(), \"w\");\n"
+            "    if(out == NULL) {\n"
+            "        perror(\"Error: Unable to open output file.\\n\");\n"
+            "        return 1;\n"
+            "    }\n"
+            "    int failed = 0;\n"
+            "    for(auto &job : jobs) {\n"
+            "        fprintf(out, \"%s %s %s\\n\", job.input.c_str(), job.output.c_str(), job.status == 0 ? \"ok\" : \"failed\");\n"
+            "        failed = failed || job.status != 0;\n"
+            "    }\n"
+            "    fclose(out);\n"
+            "    return failed;\n"
+            "}\n";
+    }
+
+    if(options.width > 0) {
+        runtime = runtime +
+            "const int FIXED_WIDTH = " + std::to_string(options.width) + ";\n"
+            "const int FIXED_HEIGHT = " + std::to_string(options.height) + ";\n"
+            "// Reads cells relative to (x, y) within a grid of the size given to emergent, wrapping by constants.\n"
+            "template<typename G>\n"
+            "struct Fixed {\n"
+            "    const G &grid;\n"
+            "    int x, y;\n"
+            "    size_t current;\n"
+            "    uint8_t centre() const {\n"
+            "        return grid[current];\n"
+            "    }\n"
+            "    uint8_t operator()(int dx) const {\n"
+            "        return grid[((x + dx) % FIXED_WIDTH + FIXED_WIDTH) % FIXED_WIDTH];\n"
+            "    }\n"
+            "    uint8_t operator()(int dx, int dy) const {\n"
+            "        int wx = ((x + dx) % FIXED_WIDTH + FIXED_WIDTH) % FIXED_WIDTH;\n"
+            "        int wy = ((y + dy) % FIXED_HEIGHT + FIXED_HEIGHT) % FIXED_HEIGHT;\n"
+            "        return grid[(size_t) wy * FIXED_WIDTH + wx];\n"
+            "    }\n"
+            "};\n";
+    }
+
+    std::string layout_gen;
+    if(options.morton) {
+        // Tables are padded by the radius on each side, so neighbours wrap without a modulo.
+        layout_gen =
+            "const int TILE = 16;\n"
+            "const int radius = " + std::to_string(radius) + ";\n"
+            + linkage() + tls + "std::vector<size_t> morton_x;\n"
+            + linkage() + tls + "std::vector<size_t> morton_y;\n"
+            + linkage() + "size_t coordinate2d(std::pair<int,int> p) {\n"
+            "    return morton_x[p.first + radius] | morton_y[p.second + radius];\n"
+            "};\n"
+            + linkage() + "int bitsFor(int length) {\n"
+            "    int bits = 0;\n"
+            "    while((1 << bits) < length) {\n"
+            "        bits++;\n"
+            "    }\n"
+            "    return bits;\n"
+            "}\n"
+            "// Interleaves the bits of x and y, until the shorter axis runs out of bits.\n"
+            + linkage() + "void layout() {\n"
+            "    int x_bits = bitsFor(width);\n"
+            "    int y_bits = bitsFor(height);\n"
+            "    std::vector<size_t> x_codes(width, 0);\n"
+            "    std::vector<size_t> y_codes(height, 0);\n"
+            "    int x_bit = 0;\n"
+            "    int y_bit = 0;\n"
+            "    for(int bit = 0; bit < x_bits + y_bits; bit++) {\n"
+            "        bool to_x = y_bit >= y_bits || (x_bit < x_bits && bit % 2 == 0);\n"
+            "        for(int i = 0; i < width && to_x; i++) {\n"
+            "            x_codes[i] |= (size_t) ((i >> x_bit) & 1) << bit;\n"
+            "        }\n"
+            "        for(int i = 0; i < height && !to_x; i++) {\n"
+            "            y_codes[i] |= (size_t) ((i >> y_bit) & 1) << bit;\n"
+            "        }\n"
+            "        if(to_x) {\n"
+            "            x_bit++;\n"
+            "        } else {\n"
+            "            y_bit++;\n"
+            "        }\n"
+            "    }\n"
+            "    morton_x.clear();\n"
+            "    morton_y.clear();\n"
+            "    for(int i = -radius; i < width + radius; i++) {\n"
+            "        morton_x.push_back(x_codes[wrap(i, width)]);\n"
+            "    }\n"
+            "    for(int i = -radius; i < height + radius; i++) {\n"
+            "        morton_y.push_back(y_codes[wrap(i, height)]);\n"
+            "    }\n"
+            "    capacity = (size_t) 1 << (x_bits + y_bits);\n"
+            "}\n";
+    } else {
+        layout_gen =
+            linkage() + "size_t coordinate2d(std::pair<int,int> p) {\n"
+            "    return wrap(p.first, width) + ((size_t) width * wrap(p.second, height));\n"
+            "};\n"
+            + linkage() + "void layout() {\n"
+            "    capacity = (size_t) width * height;\n"
+            "}\n";
+    }
+
+    // Options given to the simulator after its operands.
+    std::string options_gen =
+        "if(option == \"--map-output\") {\n"
+        "           map_output = true;\n"
+        "       } else if(option == \"--checkpoint\" && i + 2 < argc) {\n"
+        "           checkpoint_name = argv[++i];\n"
+        "           checkpoint_every = std::atoi(argv[++i]);\n"
+        "           if(checkpoint_every < 1) {\n"
+        "               std::cout << \"Error: --checkpoint expects EVERY > 0\\n\";\n"
+        "               return 1;\n"
+        "           }\n"
+        "       } else if(option == \"--resume\" && i + 1 < argc) {\n"
+        "           resume_name = argv[++i];\n"
+        "       } else if(option == \"--seed\" && i + 1 < argc) {\n"
+        "           seed = strtoull(argv[++i], NULL, 10);\n"
+        "       } else if(option == \"--frames\" && i + 2 < argc) {\n"
+        "           frame_pattern = argv[++i];\n"
+        "           frame_every = std::atoi(argv[++i]);\n"
+        "           if(frame_every < 1 || frame_pattern.find('#') == std::string::npos) {\n"
+        "               std::cout << \"Error: --frames expects a PATTERN containing # and EVERY > 0\\n\";\n"
+        "               return 1;\n"
+        "           }\n"
+        "       } else if(option == \"--region\" && i + 1 < argc) {\n"
+        "           if(sscanf(argv[++i], \"%d,%d,%dx%d\", &region_x, &region_y, &region_width, &region_height) != 4 ||\n"
+        "                   region_width < 1 || region_height < 1) {\n"
+        "               std::cout << \"Error: --region expects X,Y,WxH\\n\";\n"
+        "               return 1;\n"
+        "           }\n"
+        "       } else if((option == \"--downsample\" || option == \"--density\") && i + 1 < argc) {\n"
+        "           downsample = std::atoi(argv[++i]);\n"
+        "           density = option == \"--density\";\n"
+        "           if(downsample < 1) {\n"
+        "               std::cout << \"Error: \" + option + \" expects N > 0\\n\";\n"
+        "               return 1;\n"
+        "           }\n"
+        "       } else ";
+    std::string launch_gen;
+    if(options.ensemble) {
+        options_gen = options_gen +
+            "if(option == \"--ensemble\") {\n"
+            "           ensemble = true;\n"
+            "       } else ";
+    }
+    if(options.batch) {
+        options_gen = options_gen +
+            "if(option == \"--batch\") {\n"
+            "           batch = true;\n"
+            "       } else ";
+    }
+    if(options.unbounded) {
+        options_gen = options_gen +
+            "if(option == \"--unbounded\") {\n"
+            "           unbounded = true;\n"
+            "       } else ";
+    }
+    if(options.statistics) {
+        options_gen = options_gen +
+            "if(option == \"--stats\" && i + 1 < argc) {\n"
+            "           stats_name = argv[++i];\n"
+            "       } else ";
+    }
+    if(options.streaming) {
+        options_gen = options_gen +
+            "if(option == \"--stream\" && i + 1 < argc) {\n"
+            "           scratch = argv[++i];\n"
+            "       } else ";
+    }
+    if(options.sharding) {
+        options_gen = options_gen +
+            "if(option == \"--shards\" && i + 1 < argc) {\n"
+            "           launch = std::atoi(argv[++i]);\n"
+            "           if(launch < 1) {\n"
+            "               std::cout << \"Error: --shards expects N > 0\\n\";\n"
+            "               return 1;\n"
+            "           }\n"
+            "       } else if(option == \"--shard-timeout\" && i + 1 < argc) {\n"
+            "           shard_timeout = std::atoi(argv[++i]);\n"
+            "       } else if(option == \"--shard\" && i + 2 < argc) {\n"
+            "           if(sscanf(argv[++i], \"%d/%d\", &shard, &shards) != 2 || shard < 0 || shard >= shards) {\n"
+            "               std::cout << \"Error: --shard expects I/N with 0 <= I < N\\n\";\n"
+            "               return 1;\n"
+            "           }\n"
+            "           session = std::string(\"/emergent_\") + argv[++i];\n"
+            "       } else ";
+        launch_gen =
+            "   if(launch > 0) {\n"
+            "       // Forks a process per shard, sharing a session named after this process.\n"
+            "       session = \"/emergent_\" + std::to_string(getpid());\n"
+            "       std::vector<pid_t> children;\n"
+            "       for(int i = 0; i < launch; i++) {\n"
+            "           pid_t pid = fork();\n"
+            "           if(pid == 0) {\n"
+            "               shard = i;\n"
+            "               shards = launch;\n"
+            "               launch = 0;\n"
+            "               break;\n"
+            "           } else if(pid < 0) {\n"
+            "               perror(\"Error: Unable to fork a shard.\\n\");\n"
+            "               return 1;\n"
+            "           }\n"
+            "           children.push_back(pid);\n"
+            "       }\n"
+            "       if(launch > 0) {\n"
+            "           int failed = 0;\n"
+            "           for(size_t exited = 0; exited < children.size(); exited++) {\n"
+            "               int status;\n"
+            "               pid_t child = wait(&status);\n"
+            "               std::replace(children.begin(), children.end(), child, (pid_t) 0);\n"
+            "               if((!WIFEXITED(status) || WEXITSTATUS(status) != 0) && !failed) {\n"
+            "                   // The other shards would wait on this one forever, so they are stopped too.\n"
+            "                   failed = 1;\n"
+            "                   for(pid_t other : children) {\n"
+            "                       if(other > 0) {\n"
+            "                           kill(other, SIGTERM);\n"
+            "                       }\n"
+            "                   }\n"
+            "               }\n"
+            "           }\n"
+            "           // Shards which crashed leave the segment behind, so it's removed once they have all exited.\n"
+            "           if(failed) {\n"
+            "               shm_unlink(session.c_str());\n"
+            "           }\n"
+            "           return failed;\n"
+            "       }\n"
+            "   }\n";
+    }
+
+    std::string batch_gen;
+    if(options.batch) {
+        // INPUT names a manifest of jobs, and OUTPUT a summary of them.
+        std::string conflicts = "checkpoint_every > 0 || resume_name != \"\" || frame_every > 0";
+        if(options.sharding) {
+            conflicts = conflicts + " || launch > 0 || shards > 1";
+        }
+        if(options.streaming) {
+            conflicts = conflicts + " || scratch != \"\"";
+        }
+        if(options.statistics) {
+            conflicts = conflicts + " || stats_name != \"\"";
+        }
+        batch_gen =
+            "   if(batch && (" + conflicts + ")) {\n"
+            "       std::cout << \"Error: Batches cannot be checkpointed, resumed, framed, sharded or streamed" + std::string(options.statistics ? ", nor gather statistics" : "") + ".\\n\";\n"
+            "       return 1;\n"
+            "   }\n"
+            "   if(batch) {\n"
+            "       return runBatch(argv[1], argv[2], argv[4]);\n"
+            "   }\n";
+    }
+
+    std::string main_gen =
         "int main(int argc, char **argv) {\n"
         "   name = std::string(argv[0]);\n"
-        "   if(argc != 5) {\n"
-        "   std::cout << \"Error: Missing operands\\nUsage: ./\" +  name + \" INPUT MODEL STEPS OUTPUT\\n\";"
+        "   if(argc < 5) {\n"
+        "   std::cout << \"Error: Missing operands\\nUsage: ./\" +  name + \" INPUT MODEL STEPS OUTPUT [OPTION]...\\n\";"
         "   return 1;\n"
         "   }\n"
         "   steps = std::atoi(argv[3]);\n"
@@ -337,29 +3022,70 @@ std::string ast::Program::codegen() {
         "       std::cout << \"Error: Incorrect 3rd operand STEPS must be > 0\\n\";\n"
         "       return 1;\n"
         "   }\n" 
-        "   FILE *input = fopen(argv[1], \"r\");\n"
+        "   for(int i = 5; i < argc; i++) {\n"
+        "       std::string option(argv[i]);\n"
+        "       " + options_gen + "{\n"
+        "           std::cout << \"Error: Unknown option \" + option + \"\\n\";\n"
+        "           return 1;\n"
+        "       }\n"
+        "   }\n"
+        "   input_name = argv[1];\n"
+        "   output_name = argv[4];\n" +
+        batch_gen +
+        "   return simulate(argv[2]);\n"
+        "}\n";
+
+    // RLE names the default state of a model first, then its other states in order.
+    std::string palettes =
+        "std::string palette(const std::string &model) {\n";
+    for(auto & model : models) {
+        std::string escaped;
+        for(char c : model->palette()) {
+            escaped = escaped + (c == '\\' || c == '"' ? "\\" : "") + c;
+        }
+        palettes = palettes +
+            "    if(model == \"" + model->model_id + "\") {\n"
+            "        return \"" + escaped + "\";\n"
+            "    }\n";
+    }
+    palettes = palettes +
+        "    return \"\";\n"
+        "}\n";
+
+    // Streamed grids and shards read INPUT themselves, so only its dimensions are read here.
+    std::string store = "true";
+    if(options.streaming) {
+        store = "scratch == \"\"";
+    }
+    if(options.sharding) {
+        store = (options.streaming ? store + " && " : "") + "launch <= 1 && shards <= 1";
+    }
+
+    // Simulates a MODEL from input_name into output_name.
+    std::string main_a =
+        "int simulate(const std::string &model) {\n"
+        "   width = 0;\n"
+        "   height = 0;\n"
+        "   depth = 0;\n"
+        "   characters.clear();\n"
+        "   FILE *input = fopen(input_name.c_str(), \"r\");\n"
         "   if(input == NULL) {\n"
         "       perror(\"Error: Unable to open input file.\\n\");\n"
         "       return 1;\n"
         "   }\n"
-        "   int pos = 0;\n"
-        "   char c;\n"
-        "   while((c = getc(input)) != EOF) {\n"
-        "       if(c == \'\\n\' || c == \'\\r\') {\n"
-        "           height++;\n"
-        "           pos = 0;\n"
-        "       } else {\n"
-        "           prev.push_back(c);\n"
-        "       }\n"
-        "       pos++;\n"
-        "       if(height == 0) {\n"
-        "           width = pos;\n"
-        "       } else if(pos > width) {\n"
-        "           std::cout << \"Error: Contradicing dimensions within INPUT file.\\n\";\n"
-        "           return 1;\n"
-        "       }\n"
+        "   std::string read = isRle(input_name) ? readRle(input, palette(model)) : readDense(input, " + store + ");\n"
+        "   fclose(input);\n"
+        "   if(read != \"\") {\n"
+        "       std::cout << read + \"\\n\";\n"
+        "       return 1;\n"
+        "   }\n"
+        "   // RLE holds a single layer, so 3D grids are rejected before they are simulated.\n"
+        "   if(depth > 1 && isRle(output_name)) {\n"
+        "       std::cout << \"Error: RLE OUTPUT holds only 1D and 2D grids.\\n\";\n"
+        "       return 1;\n"
         "   }\n"
-        "   std::string model(argv[2]);"
+        "   layout();\n" +
+        launch_gen +
         "   std::string error;\n    ";
 
     std::string cases;
@@ -378,19 +3104,57 @@ std::string ast::Program::codegen() {
         " {\n"
         "       std::cout << \"Error: Incorrect 2nd operand MODEL must be a name of a model\\n\";\n"
         "       return 1;\n"
-        "   }\n"
-        "   fclose(input);\n"
-        "   FILE *output = fopen(argv[4], \"w\");\n"
-        "   pos = 0;\n"
-        "   while(pos < prev.size()) {\n"
-        "       putc(prev.at(pos), output);\n"
-        "       pos++;\n"
-        "       if(pos % width == 0) {\n"
-        "           putc(\'n\', output);\n"
-        "       }\n"
+        "   }\n" +
+        std::string(options.sharding ?
+        "   if(shards > 1) {\n"
+        "       return 0;\n"
+        "   }\n" : "") +
+        std::string(options.streaming ?
+        "   if(scratch != \"\") {\n"
+        "       return 0;\n"
+        "   }\n" : "") +
+        "   if(!(isRle(output_name) ? writeRle(palette(model)) : writeOutput())) {\n"
+        "       perror(\"Error: Unable to write output file.\\n\");\n"
+        "       return 1;\n"
         "   }\n"
         "   return 0;\n"
         "}\n";
 
-    return preamble + neighbourhoods_gen + models_gen + main_a + cases + main_b;
+    if(options.sharding) {
+        preamble =
+            "#include <sys/wait.h>\n"
+            "#include <sys/syscall.h>\n"
+            "#include <linux/futex.h>\n"
+            "#include <climits>\n"
+            "#include <signal.h>\n" +
+            preamble;
+    }
+    if(options.split == "") {
+        return preamble + shared + layout_gen + runtime + neighbourhoods_gen + models_gen + palettes + main_a + cases + main_b + main_gen;
+    }
+
+    // The runtime and neighbourhoods go in a header, each model in a unit of its own, and
+    // the dispatcher in the main unit, so models build in parallel and only when changed.
+    std::string name = options.split;
+    units.clear();
+    units[".hpp"] = "#pragma once\n" + preamble + shared + layout_gen + runtime + neighbourhoods_gen;
+    std::string declarations;
+    std::string objects = name + ".o";
+    for(size_t i = 0; i < models.size(); i++) {
+        std::string id = models[i]->model_id;
+        units["_" + id + ".cpp"] = "#include \"" + name + ".hpp\"\n" + model_units[i];
+        declarations = declarations + "const char* " + id + "();\n";
+        objects = objects + " " + name + "_" + id + ".o";
+    }
+    units[".mk"] =
+        "# Builds the simulator a unit at a time, e.g. make -j -f " + name + ".mk\n"
+        "CXXFLAGS ?= -std=c++17 -O2\n" +
+        (options.library != "" ?
+        "CPPFLAGS += -I " + options.library + "\n"
+        "LDLIBS += " + options.library + "/libemergent.a\n" : "") +
+        name + ": " + objects + "\n"
+        "\t$(CXX) $(CXXFLAGS) $^ $(LDLIBS) -pthread -o $@\n"
+        "%.o: %.cpp " + name + ".hpp\n"
+        "\t$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c $< -o $@\n";
+    return "#include \"" + name + ".hpp\"\n" + declarations + palettes + main_a + cases + main_b + main_gen;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "ast.hpp"
+#include "lexer.hpp"
+#include <map>
+#include <vector>
+
+using namespace ast;
+
+// Largest amount of assignments enumerated whilst building a diagram.
+static const long MAX_ASSIGNMENTS = 1 << 16;
+
+bool ast::Node::evaluate(Assignment &, int &) {
+  return false;
+}
+
+bool ast::Binary::evaluate(Assignment &assignment, int &value) {
+  // Both sides are always evaluated, so every cell is collected.
+  int l, r;
+  if(!left->evaluate(assignment, l) || !right->evaluate(assignment, r)) {
+    return false;
+  }
+  switch(operation) {
+    case AND: value = l && r; return true;
+    case OR: value = l || r; return true;
+    case XOR: value = (l && !r) || (!l && r); return true;
+    case EQ: value = l == r; return true;
+    case NE: value = l != r; return true;
+    default: break;
+  }
+  return false;
+}
+
+bool ast::Coordinate::evaluate(Assignment &assignment, int &value) {
+  if((size_t) assignment.dimensions != vector->items.size()) {
+    return false;
+  }
+  std::string key = vector->codegen();
+  if(!assignment.cells.count(key)) {
+    if(!assignment.collecting) {
+      return false;
+    }
+    assignment.cells[key] = assignment.reads.size();
+    assignment.reads.push_back(shared_from_this());
+    assignment.values.push_back(0);
+  }
+  value = assignment.values[assignment.cells[key]];
+  return true;
+}
+
+bool ast::Identifier::evaluate(Assignment &assignment, int &value) {
+  if(id == "this") {
+    if(!assignment.cells.count(id)) {
+      if(!assignment.collecting) {
+        return false;
+      }
+      assignment.cells[id] = assignment.reads.size();
+      assignment.reads.push_back(shared_from_this());
+      assignment.values.push_back(0);
+    }
+    value = assignment.values[assignment.cells[id]];
+    return true;
+  }
+  // Neighbour names shadow state names.
+  if(assignment.names.count(id)) {
+    return assignment.names[id]->evaluate(assignment, value);
+  }
+  if(assignment.states.count(id)) {
+    value = assignment.states[id];
+    return true;
+  }
+  return false;
+}
+
+bool ast::Negation::evaluate(Assignment &assignment, int &result) {
+  int v;
+  if(!value->evaluate(assignment, v)) {
+    return false;
+  }
+  result = !v;
+  return true;
+}
+
+bool ast::State::evaluate(Assignment &assignment, bool &holds) {
+  if(!predicate) {
+    holds = false;
+    return true;
+  }
+  int value;
+  if(!predicate->evaluate(assignment, value)) {
+    return false;
+  }
+  holds = value;
+  return true;
+}
+
+void ast::Neighbour::decide(Assignment &assignment) {
+  if(id != "") {
+    assignment.names[id] = coordinate;
+  }
+}
+
+void ast::Neighbourhood::decide(Assignment &assignment) {
+  assignment.dimensions = dimensions;
+  for(auto neighbour : neighbours->items) {
+    neighbour->decide(assignment);
+  }
+}
+
+// Returns the vertex for the given children, sharing any identical vertex.
+int uniqueVertex(
+  Diagram &diagram,
+  std::map<std::pair<int, std::vector<int>>, int> &unique,
+  int variable,
+  std::vector<int> children
+) {
+  auto key = std::make_pair(variable, children);
+  auto it = unique.find(key);
+  if(it != unique.end()) {
+    return it->second;
+  }
+  diagram.vertices.push_back({variable, children});
+  unique[key] = diagram.vertices.size() - 1;
+  return diagram.vertices.size() - 1;
+}
+
+// Builds the diagram for all variables from the given one onwards, returning its root.
+int buildVertex(
+  Diagram &diagram,
+  std::map<std::pair<int, std::vector<int>>, int> &unique,
+  Assignment &assignment,
+  std::vector<std::shared_ptr<State>> &states,
+  int variable,
+  int fallback
+) {
+  if((size_t) variable == assignment.values.size()) {
+    // States' predicates are tested in order, the first to hold is next.
+    for(size_t i = 0; i < states.size(); i++) {
+      bool holds = false;
+      if(!states[i]->is_default) {
+        states[i]->evaluate(assignment, holds);
+      }
+      if(holds) {
+        return uniqueVertex(diagram, unique, -1, {(int) i});
+      }
+    }
+    return uniqueVertex(diagram, unique, -1, {fallback});
+  }
+
+  std::vector<int> children;
+  for(int value = 0; value < diagram.values; value++) {
+    assignment.values[variable] = value;
+    children.push_back(buildVertex(diagram, unique, assignment, states, variable + 1, fallback));
+  }
+  // Reduces vertices which don't depend on their variable.
+  bool redundant = true;
+  for(int child : children) {
+    redundant = redundant && child == children[0];
+  }
+  if(redundant) {
+    return children[0];
+  }
+  return uniqueVertex(diagram, unique, variable, children);
+}
+
+void ast::Model::decide(std::shared_ptr<Neighbourhood> neighbourhood) {
+  Assignment assignment;
+  neighbourhood->decide(assignment);
+
+  auto diagram = std::make_shared<Diagram>();
+  int fallback = -1;
+  for(size_t i = 0; i < states->items.size(); i++) {
+    auto state = states->items[i];
+    assignment.states[state->id] = i;
+    if(state->is_default) {
+      fallback = i;
+    }
+  }
+  if(fallback < 0) {
+    return;
+  }
+  diagram->values = states->items.size();
+
+  assignment.collecting = true;
+  for(auto state : states->items) {
+    bool holds;
+    if(!state->evaluate(assignment, holds)) {
+      return;
+    }
+  }
+  assignment.collecting = false;
+
+  long assignments = 1;
+  for(size_t i = 0; i < assignment.values.size(); i++) {
+    assignments *= diagram->values;
+    if(assignments > MAX_ASSIGNMENTS) {
+      return;
+    }
+  }
+
+  std::map<std::pair<int, std::vector<int>>, int> unique;
+  diagram->reads = assignment.reads;
+  diagram->root = buildVertex(*diagram, unique, assignment, states->items, 0, fallback);
+  this->diagram = diagram;
+}
+
+void ast::Program::decide() {
+  for(auto model : models) {
+    for(auto neighbourhood : neighbourhoods) {
+      if(neighbourhood->id == model->neighbourhood_id) {
+        model->decide(neighbourhood);
+      }
+    }
+  }
+}
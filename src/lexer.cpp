@@ -80,6 +80,7 @@ lexer::TOKEN lexer::getToken(FILE *file) {
     keywords["default"] = DEFAULT;
     keywords["this"] = THIS;
     keywords["in"] = IN;
+    keywords["random"] = RANDOM;
     keywords["and"] = AND;
     keywords["or"] = OR;
     keywords["xor"] = XOR;
@@ -100,10 +101,10 @@ lexer::TOKEN lexer::getToken(FILE *file) {
     integer = strtod(wholes.c_str(), nullptr);
 
     if(prev == '.') {
-        // Returns digits after the point.
+        // Returns the point and the digits after it.
         std::string fractions = iterDigits(file);
         decimal = strtof(fractions.c_str(), nullptr) + integer;
-        return returnToken(wholes + '.' + fractions, DEC_LIT);
+        return returnToken(wholes + fractions, DEC_LIT);
     } else {
         // Must be whole number, as there is no point.
         return returnToken(wholes, NAT_LIT);
@@ -22,6 +22,7 @@ namespace lexer {
     DEFAULT = -8,       // Default Tag "default"
     THIS = -9,          // Cell pointed to "this"
     IN = -10,           // Indicator for aggratation "in"
+    RANDOM = -22,       // Uniform random number in [0, 1) "random"
 
     // Literals
     NAT_LIT = -11, // Integer [0-9]+
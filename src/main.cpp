@@ -3,6 +3,8 @@
 #include <string>
 #include <system_error>
 #include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
 #include "ast.hpp"
 #include "parser.hpp"
 
@@ -15,24 +17,203 @@ void spit(std::string text) {
   }
 }
 
+// Writes code to target, unless it already holds that code, so unchanged units aren't rebuilt.
+bool emit(const std::string &target, const std::string &code) {
+  FILE *existing = fopen(target.c_str(), "r");
+  if(existing != NULL) {
+    std::string old;
+    char buffer[4096];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), existing)) > 0) {
+      old.append(buffer, n);
+    }
+    fclose(existing);
+    if(old == code) {
+      return true;
+    }
+  }
+  FILE *object = fopen(target.c_str(), "w");
+  if(object == NULL) {
+    return false;
+  }
+  fputs(code.c_str(), object);
+  return fclose(object) == 0;
+}
+
+// Returns the directory holding this executable, where make puts the prebuilt runtime.
+std::string home() {
+  char path[4096];
+  ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  std::string exe = length > 0 ? std::string(path, length) : ".";
+  return exe.substr(0, exe.find_last_of('/'));
+}
+
+// Quotes text for the shell.
+std::string quote(const std::string &text) {
+  std::string quoted = "'";
+  for(char c : text) {
+    quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+  }
+  return quoted + "'";
+}
+
+// Runs command through the shell, returning whether it succeeded.
+bool run(const std::string &command) {
+  spit(command);
+  return system(command.c_str()) == 0;
+}
+
+// Compiles the simulator emitted to stem.cpp into stem, with flags tuned for speed. Given a training
+// INPUT, simulators are first built instrumented and run for 10 generations of it, then rebuilt with the profile.
+bool build(const std::string &stem, const std::vector<std::string> &models, const std::string &training) {
+  const char *cxx = getenv("CXX");
+  std::string compiler = cxx != NULL ? cxx : "clang++";
+  // Link-time optimisation only pays off across the units of split simulators.
+  std::string flags = "-std=c++17 -O3 -march=native" + std::string(ast::options.split != "" ? " -flto" : "");
+  std::string library = ast::options.library;
+  std::string executable = stem.find('/') == std::string::npos ? "./" + stem : stem;
+  // Split simulators build through their makefile, so their units compile in parallel, and only when
+  // changed unless rebuilt, as objects built with other flags would otherwise be kept.
+  auto compile = [&](const std::string &extra, bool rebuild) {
+    if(ast::options.split != "") {
+      std::string directory = stem.substr(0, stem.size() - ast::options.split.size());
+      return run("make -s" + std::string(rebuild ? " -B" : "") + " -j -C " + quote(directory == "" ? "." : directory) + " -f " + quote(ast::options.split + ".mk") +
+        " CXX=" + quote(compiler) + " CXXFLAGS=" + quote(flags + extra));
+    }
+    return run(compiler + " " + flags + extra + " " + quote(stem + ".cpp") +
+      (library != "" ? " -I " + quote(library) + " " + quote(library + "/libemergent.a") : "") +
+      " -pthread -o " + quote(executable));
+  };
+  if(training == "") {
+    return compile("", false);
+  }
+  // Profiles are named absolutely, since split simulators build in their own directory.
+  char cwd[4096];
+  std::string profile = (stem[0] == '/' || getcwd(cwd, sizeof(cwd)) == NULL ? "" : std::string(cwd) + "/") + stem + ".profile";
+  if(!run("rm -rf " + quote(profile)) || !compile(" -fprofile-generate=" + quote(profile), true)) {
+    return false;
+  }
+  // Models that can't simulate the training INPUT are left out of the profile.
+  bool trained = false;
+  for(auto & model : models) {
+    trained = run(quote(executable) + " " + quote(training) + " " + quote(model) + " 10 /dev/null > /dev/null") || trained;
+  }
+  if(!trained) {
+    std::cout << "Error: No model could simulate the --pgo INPUT\n";
+    return false;
+  }
+  // Clang's raw profiles are merged first, whereas GCC reads them as they are.
+  if(run(compiler + " --version | grep -q clang")) {
+    std::string merged = profile + "/default.profdata";
+    return run("llvm-profdata merge -o " + quote(merged) + " " + quote(profile)) && compile(" -fprofile-use=" + quote(merged), true);
+  }
+  return compile(" -fprofile-use=" + quote(profile) + " -Wno-missing-profile", true);
+}
+
 int main(int argc, char **argv) {
   if(argc < 2) {
     std::cout << "Error: Missing operand\nUsage: ./emergent [OPTION]... SOURCE.emg\n";
     return 1;
   }
+  // Emits the runtime shared by every simulator, for the Makefile to build into a library.
+  if(argc == 3 && std::string(argv[1]) == "--runtime") {
+    for(auto & unit : ast::runtimeLibrary()) {
+      if(!emit(std::string(argv[2]) + "/runtime" + unit.first, unit.second)) {
+        perror(("Error: Couldn't create runtime" + unit.first + " file.").c_str());
+        return 1;
+      }
+    }
+    return 0;
+  }
   int top = argc - 1;
   bool ast = false;
+  bool decide = false;
+  bool split = false;
+  bool optimise = false;
+  std::string training;
   for(int i = 1; i < argc; i++) {
     std::string option(argv[i]);
     if(option == "-t") {
       ast = true;
+    } else if(option == "-d") {
+      decide = true;
+    } else if(option == "-z") {
+      ast::options.morton = true;
+    } else if(option == "-b") {
+      ast::options.blocking = true;
+    } else if(option == "-s") {
+      ast::options.sharding = true;
+    } else if(option == "-c") {
+      ast::options.cycles = true;
+    } else if(option == "-a") {
+      ast::options.statistics = true;
+    } else if(option == "-o") {
+      ast::options.streaming = true;
+    } else if(option == "-u") {
+      ast::options.unbounded = true;
+    } else if(option == "-m") {
+      ast::options.batch = true;
+    } else if(option == "-e") {
+      ast::options.ensemble = true;
+    } else if(option == "-l") {
+      ast::options.library = home();
+    } else if(option == "--size" && i + 1 < top) {
+      int fields = sscanf(argv[++i], "%dx%d", &ast::options.width, &ast::options.height);
+      if(fields == 1) {
+        ast::options.height = 1;
+      }
+      if(fields < 1 || ast::options.width < 1 || ast::options.height < 1) {
+        std::cout << "Error: --size expects WxH, or W for 1D grids\n";
+        return 1;
+      }
+    } else if(option == "--build") {
+      optimise = true;
+    } else if(option == "--pgo" && i + 1 < top) {
+      optimise = true;
+      training = argv[++i];
+    } else if(option == "--split") {
+      split = true;
     } else if(option == "-v") {
       verbose = true;
     } else if(option == "--help") {
       std::cout << "Usage: ./emergent [OPTION]... SOURCE.emg\n"
-        "Compiles any *.emg Emergent source code into C++.\n\n" 
+        "  or:  ./emergent --runtime DIR\n"
+        "Compiles any *.emg Emergent source code into C++, or emits the\n"
+        "runtime shared by simulators into DIR, as make runtime does.\n\n" 
         "All possible options:\n"
         "   -t      Prints the parsed syntax tree.\n"
+        "   -d      Compiles predicates into decision diagrams where possible.\n"
+        "   -z      Stores 2D grids in Z-order, for locality on wide grids.\n"
+        "   -b      Advances tiles of the grid several generations at a time.\n"
+        "   -s      Lets 2D simulators run as shards in separate processes,\n"
+        "           exchanging rows through POSIX shared memory, each waiting\n"
+        "           on its neighbours for at most --shard-timeout SECONDS if set.\n"
+        "   -c      Stops simulating once the grid repeats an earlier generation,\n"
+        "           skipping straight to the state reached after STEPS.\n"
+        "   -a      Lets simulators write the count of each state and the bounds\n"
+        "           of the rest every generation to --stats FILE, as CSV if it\n"
+        "           ends in .csv, otherwise binary.\n"
+        "   -o      Lets 2D simulators stream grids larger than memory\n"
+        "           through files on disk.\n"
+        "   -u      Lets 2D simulators grow grids over an unbounded plane,\n"
+        "           storing only chunks which leave the default state.\n"
+        "   -m      Lets simulators run a manifest of INPUT and OUTPUT pairs\n"
+        "           on a pool of threads.\n"
+        "   -e      Lets 1D and 2D simulators advance each layer of INPUT as an\n"
+        "           instance of an ensemble, interleaved so that a branch-free\n"
+        "           rule advances a cell of 16 instances at once in vector lanes.\n"
+        "   -l      Links simulators against the prebuilt runtime, compiling them\n"
+        "           with -I bin bin/libemergent.a, bin being beside emergent.\n"
+        "   --size WxH\n"
+        "           Specialises the sweep of 1D and 2D simulators for grids of\n"
+        "           W by H cells, falling back to any size at runtime.\n"
+        "   --split Emits a header, a unit per model and a makefile building\n"
+        "           them in parallel, besides the dispatching SOURCE.cpp.\n"
+        "   --build Compiles SOURCE.cpp into a simulator with $CXX, or clang++,\n"
+        "           at -O3 for this machine, optimising across units if split.\n"
+        "   --pgo INPUT\n"
+        "           Builds as --build does, but profiles each model simulating\n"
+        "           INPUT first, which should be like the grids simulated.\n"
         "   -v      Prints all the stages of the compiler\n"
         "   --help  Displays this message.\n";
       return 0;
@@ -51,6 +232,11 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if(ast::options.library != "" && ast::options.batch) {
+    std::cout << "Error: Batches keep a grid per thread, unlike the prebuilt runtime\n";
+    return 1;
+  }
+
   if(parser::openFile(argv[top])) {
     perror("Error: Unable to open SOURCE file\n"); // Returns error for open() also
     return 1;
@@ -73,21 +259,39 @@ int main(int argc, char **argv) {
   }
   parser::closeFile();
   spit("Source file closed Successfully!");
+  if(decide) {
+    spit("Building Decision Diagrams...\n");
+    program->decide();
+    spit("Decision Diagrams Built!\n");
+  }
+  if(split) {
+    int slash = name.find_last_of('/');
+    ast::options.split = name.substr(slash + 1, i - slash - 1);
+  }
   spit("Code Generating...\n");
   std::string code = program->codegen();
   spit("Code Generation Successful!\n");
   spit("Outputting object...\n");
 
   std::string target = name.substr(0, i) + ".cpp";
-  FILE *object = fopen(target.c_str(), "w");
-  
-  if(object == NULL) {
+  if(!emit(target, code)) {
     perror("Error: Couldn't create object.cpp file.");
     return 1;
   }
-
-  fputs(code.c_str(), object);
-  fclose(object);
+  for(auto & unit : program->units) {
+    if(!emit(name.substr(0, i) + unit.first, unit.second)) {
+      perror(("Error: Couldn't create " + unit.first + " file.").c_str());
+      return 1;
+    }
+  }
   spit("Object file Successful!\n");
+  if(optimise) {
+    spit("Building simulator...\n");
+    if(!build(name.substr(0, i), program->modelIds(), training)) {
+      std::cout << "Error: Unable to build the simulator\n";
+      return 1;
+    }
+    spit("Simulator built!\n");
+  }
   return 0;
 }
@@ -277,8 +277,18 @@ std::shared_ptr<State> parser::ParseState() {
       return nullptr;
     }
     char character = token.lexeme.at(0);
-
-    return std::make_shared<State>(true, id, character);
+    // The colour is optional, so the token after the character is put back unless it starts one.
+    TOKEN character_token = token;
+    nextToken();
+    if(token.type != LSQUAR) {
+      prevToken(character_token);
+      return std::make_shared<State>(true, id, character, nullptr);
+    }
+    auto colour = ParseColour();
+    if(!colour) {
+      return nullptr;
+    }
+    return std::make_shared<State>(true, id, character, colour);
   } else if(token.type == STATE) {
     nextToken();
     if(token.type != ID) {
@@ -293,13 +303,21 @@ std::shared_ptr<State> parser::ParseState() {
     }
     char character = token.lexeme.at(0);
     nextToken();
+    std::shared_ptr<Colour> colour;
+    if(token.type == LSQUAR) {
+      colour = ParseColour();
+      if(!colour) {
+        return nullptr;
+      }
+      nextToken();
+    }
     if(token.type != LBRACE) {
-      ParsingError("State", "\'{\'");
+      ParsingError("State", "\'[\' or \'{\'");
       return nullptr;
     }
     nextToken();
     if(token.type == RBRACE) {
-      return std::make_shared<State>(false, id, character);
+      return std::make_shared<State>(false, id, character, colour);
     } else {
       auto predicate = ParsePredicate();
       if(!predicate) {
@@ -310,13 +328,36 @@ std::shared_ptr<State> parser::ParseState() {
         ParsingError("State", "\'}\'");
         return nullptr;
       }
-      return std::make_shared<State>(id, character, predicate);
+      return std::make_shared<State>(id, character, colour, predicate);
     }
   }
   ParsingError("State", "\'default\' or \'state\'");
   return nullptr;
 }
 
+std::shared_ptr<Colour> parser::ParseColour() {
+  if(token.type != LSQUAR) {
+    ParsingError("Colour", "\'[\'");
+    return nullptr;
+  }
+  int channels[3];
+  for(int i = 0; i < 3; i++) {
+    nextToken();
+    // Longer literals are rejected before stoi, which would throw on those out of int's range.
+    if(token.type != NAT_LIT || token.lexeme.size() > 3 || std::stoi(token.lexeme) > 255) {
+      ParsingError("Colour", "natural literal from 0 to 255");
+      return nullptr;
+    }
+    channels[i] = std::stoi(token.lexeme);
+    nextToken();
+    if(token.type != (i < 2 ? COMMA : RSQUAR)) {
+      ParsingError("Colour", i < 2 ? "\',\'" : "\']\'");
+      return nullptr;
+    }
+  }
+  return std::make_shared<Colour>(channels[0], channels[1], channels[2]);
+}
+
 std::shared_ptr<Node> parser::ParsePredicate() {
   std::vector<TOKEN_TYPE> first_set = {OR};
   std::vector<TOKEN_TYPE> follow_set = {RBRACE, PIPE, RPAREN};
@@ -417,8 +458,9 @@ std::shared_ptr<Node> parser::ParseElement() {
     case DEC_LIT: return std::make_shared<Decimal>(std::stof(token.lexeme));
     case ID:
     case THIS: return std::make_shared<Identifier>(token.lexeme);
+    case RANDOM: return std::make_shared<Random>();
   }
-  ParsingError("Element", "\'-\', \'not\', \'(\', \'[\', \'|\', \'this\', identifier, natural literal or decimal literal");
+  ParsingError("Element", "\'-\', \'not\', \'(\', \'[\', \'|\', \'this\', \'random\', identifier, natural literal or decimal literal");
   return nullptr;
 }
 
@@ -56,11 +56,19 @@ namespace parser {
 
    /*
       state -> DEFAULT STATE ID CHAR
+      state -> DEFAULT STATE ID CHAR colour
       state -> STATE ID CHAR LBRACE pred RBRACE
       state -> STATE ID CHAR LBRACE RBRACE
+      state -> STATE ID CHAR colour LBRACE pred RBRACE
+      state -> STATE ID CHAR colour LBRACE RBRACE
    */
    std::shared_ptr<State> ParseState();
 
+   /*
+      colour -> LSQUAR NAT_LIT COMMA NAT_LIT COMMA NAT_LIT RSQUAR
+   */
+   std::shared_ptr<Colour> ParseColour();
+
    /*
       pred -> ex_disj pred_tail
       pred_tail -> OR ex_disj pred_tail
@@ -125,6 +133,7 @@ namespace parser {
       element -> DEC_LIT
       element -> PIPE set PIPE
       element -> THIS
+      element -> RANDOM
       element -> ID
       element -> coord
    */
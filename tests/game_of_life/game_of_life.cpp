@@ -0,0 +1,284 @@
+#include <iostream>
+#include <deque>
+#include <string.h>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <stdint.h>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include "runtime.hpp"
+#if EMERGENT_RUNTIME != 4
+#error "runtime.hpp is of another version of Emergent, so rebuild libemergent.a"
+#endif
+size_t coordinate2d(std::pair<int,int> p) {
+    return wrap(p.first, width) + ((size_t) width * wrap(p.second, height));
+};
+void layout() {
+    capacity = (size_t) width * height;
+}
+template<int BITS>
+class Grid {
+    static const int PER_BYTE = 8 / BITS;
+    static const uint8_t MASK = (1 << BITS) - 1;
+    std::vector<uint8_t> bytes;
+    size_t cells;
+  public:
+    Grid(size_t cells) : bytes((cells + PER_BYTE - 1) / PER_BYTE), cells(cells) {};
+    size_t size() const {
+        return cells;
+    }
+    // Clears the grid to hold the given number of cells, reusing its bytes.
+    void reset(size_t cells) {
+        bytes.assign((cells + PER_BYTE - 1) / PER_BYTE, 0);
+        this->cells = cells;
+    }
+    uint8_t operator[](size_t i) const {
+        return (bytes[i / PER_BYTE] >> ((i % PER_BYTE) * BITS)) & MASK;
+    }
+    const std::vector<uint8_t> &data() const {
+        return bytes;
+    }
+    void set(size_t i, uint8_t state) {
+        uint8_t &byte = bytes[i / PER_BYTE];
+        int shift = (i % PER_BYTE) * BITS;
+        byte = (byte & ~(MASK << shift)) | (state << shift);
+    }
+};
+// Reads cells relative to (x, y), wrapping around the edges of the grid.
+template<typename G>
+struct Wrapped {
+    const G &grid;
+    int x, y;
+    size_t current;
+    uint8_t centre() const {
+        return grid[current];
+    }
+    uint8_t operator()(int dx) const {
+        return grid[coordinate1d(x + dx)];
+    }
+    uint8_t operator()(int dx, int dy) const {
+        return grid[coordinate2d({x + dx, y + dy})];
+    }
+};
+// Reads cells relative to current, within unpacked cells with the given row and plane strides.
+struct Local {
+    const uint8_t *cells;
+    int stride;
+    int64_t plane, current;
+    uint8_t centre() const {
+        return cells[current];
+    }
+    uint8_t operator()(int dx) const {
+        return cells[current + dx];
+    }
+    uint8_t operator()(int dx, int dy) const {
+        return cells[current + dy * stride + dx];
+    }
+    uint8_t operator()(int dx, int dy, int dz) const {
+        return cells[current + dz * plane + dy * stride + dx];
+    }
+};
+template<int BITS>
+bool encode(const std::vector<char> &states, Grid<BITS> &grid) {
+    uint8_t indices[256];
+    memset(indices, 0xFF, sizeof(indices));
+    for(int i = 0; i < (int) states.size(); i++) {
+        indices[(unsigned char) states[i]] = i;
+    }
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            uint8_t state = indices[(unsigned char) characters[(size_t) y * width + x]];
+            if(state == 0xFF) {
+                return false;
+            }
+            grid.set(coordinate2d({x,y}), state);
+        }
+    }
+    return true;
+}
+template<int BITS>
+void decode(const std::vector<char> &states, const Grid<BITS> &grid) {
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            characters[(size_t) y * width + x] = states[grid[coordinate2d({x,y})]];
+        }
+    }
+}
+constexpr std::array<std::pair<int,int>, 8> moore = {{
+   {-1, 1}, {0, 1}, {1, 1}, {-1, 0}, {1, 0}, {-1, -1}, {0, -1}, {1, -1}
+}};
+template<typename Cells>
+uint8_t conway_rule(const Cells &cells, const Dice &dice) {
+    if(((countIf(moore, [&](std::pair<int, int> cell) { return(cells(cell.first, cell.second) == 0);}) <= 3) && (countIf(moore, [&](std::pair<int, int> cell) { return(cells(cell.first, cell.second) == 0);}) >= 2))) {
+        return 0;
+    } else {
+        return 1;
+    }
+}
+const char* conway() {
+   const std::vector<char> states = {'@', '-'};
+   const std::vector<uint32_t> colours = {16777215, 0};
+   if(depth > 1) {
+       return "Error: Expected 2 Dimensions for INPUT.";
+   }
+   Grid<1> prev(capacity);
+   if(!encode(states, prev)) {
+       return "Error: Unrecognised state within INPUT.";
+   }
+   Grid<1> next(capacity);
+   int t = 0;
+   if(resume_name != "") {
+       Resumed resumed(states.size());
+       if(*resumed.error) {
+           return resumed.error;
+       }
+       t = resumed.generation;
+       for(int z = 0; z < depth; z++) {
+           for(int y = 0; y < height; y++) {
+               for(int x = 0; x < width; x++) {
+                   prev.set(coordinate2d({x,y}), resumed(x, y, z));
+               }
+           }
+       }
+   }
+   Checkpointer checkpointer;
+   Framer framer;
+   const uint8_t background = 1;
+   for(; t < steps; t++) {
+       for(int y = 0; y < height; y++) {
+       for(int x = 0; x < width; x++) {
+           size_t current = coordinate2d({x,y});
+           uint8_t state = conway_rule(Wrapped<Grid<1>>{prev, x, y, current}, Dice{t, x, y, 0});
+           next.set(current, state);
+       }
+       }
+       std::swap(next, prev);
+       if(checkpoint_every > 0 && (t + 1) / checkpoint_every > t / checkpoint_every &&
+               !checkpointer.save((t + 1), states.size(), [&](int x, int y, int z) { return prev[coordinate2d({x,y})]; })) {
+           return "Error: Unable to write a checkpoint.";
+       }
+       if(frame_every > 0 && (t + 1) / frame_every > t / frame_every &&
+               !framer.save((t + 1), states, colours, background, [&](int x, int y, int z) { return prev[coordinate2d({x,y})]; })) {
+           return "Error: Unable to write a frame.";
+       }
+   }
+   if(!checkpointer.finish()) {
+       return "Error: Unable to write a checkpoint.";
+   }
+   if(!framer.finish()) {
+       return "Error: Unable to write a frame.";
+   }
+   decode(states, prev);
+   return "";
+}
+std::string palette(const std::string &model) {
+    if(model == "conway") {
+        return "-@";
+    }
+    return "";
+}
+int simulate(const std::string &model) {
+   width = 0;
+   height = 0;
+   depth = 0;
+   characters.clear();
+   FILE *input = fopen(input_name.c_str(), "r");
+   if(input == NULL) {
+       perror("Error: Unable to open input file.\n");
+       return 1;
+   }
+   std::string read = isRle(input_name) ? readRle(input, palette(model)) : readDense(input, true);
+   fclose(input);
+   if(read != "") {
+       std::cout << read + "\n";
+       return 1;
+   }
+   // RLE holds a single layer, so 3D grids are rejected before they are simulated.
+   if(depth > 1 && isRle(output_name)) {
+       std::cout << "Error: RLE OUTPUT holds only 1D and 2D grids.\n";
+       return 1;
+   }
+   layout();
+   std::string error;
+    if(model == "conway") {
+       if((error = conway()) != "") {
+           std::cout << error + "\n";
+           return 1;
+       }
+   } else  {
+       std::cout << "Error: Incorrect 2nd operand MODEL must be a name of a model\n";
+       return 1;
+   }
+   if(!(isRle(output_name) ? writeRle(palette(model)) : writeOutput())) {
+       perror("Error: Unable to write output file.\n");
+       return 1;
+   }
+   return 0;
+}
+int main(int argc, char **argv) {
+   name = std::string(argv[0]);
+   if(argc < 5) {
+   std::cout << "Error: Missing operands\nUsage: ./" +  name + " INPUT MODEL STEPS OUTPUT [OPTION]...\n";   return 1;
+   }
+   steps = std::atoi(argv[3]);
+   if(steps == 0) {
+       std::cout << "Error: Incorrect 3rd operand STEPS must be > 0\n";
+       return 1;
+   }
+   for(int i = 5; i < argc; i++) {
+       std::string option(argv[i]);
+       if(option == "--map-output") {
+           map_output = true;
+       } else if(option == "--checkpoint" && i + 2 < argc) {
+           checkpoint_name = argv[++i];
+           checkpoint_every = std::atoi(argv[++i]);
+           if(checkpoint_every < 1) {
+               std::cout << "Error: --checkpoint expects EVERY > 0\n";
+               return 1;
+           }
+       } else if(option == "--resume" && i + 1 < argc) {
+           resume_name = argv[++i];
+       } else if(option == "--seed" && i + 1 < argc) {
+           seed = strtoull(argv[++i], NULL, 10);
+       } else if(option == "--frames" && i + 2 < argc) {
+           frame_pattern = argv[++i];
+           frame_every = std::atoi(argv[++i]);
+           if(frame_every < 1 || frame_pattern.find('#') == std::string::npos) {
+               std::cout << "Error: --frames expects a PATTERN containing # and EVERY > 0\n";
+               return 1;
+           }
+       } else if(option == "--region" && i + 1 < argc) {
+           if(sscanf(argv[++i], "%d,%d,%dx%d", &region_x, &region_y, &region_width, &region_height) != 4 ||
+                   region_width < 1 || region_height < 1) {
+               std::cout << "Error: --region expects X,Y,WxH\n";
+               return 1;
+           }
+       } else if((option == "--downsample" || option == "--density") && i + 1 < argc) {
+           downsample = std::atoi(argv[++i]);
+           density = option == "--density";
+           if(downsample < 1) {
+               std::cout << "Error: " + option + " expects N > 0\n";
+               return 1;
+           }
+       } else {
+           std::cout << "Error: Unknown option " + option + "\n";
+           return 1;
+       }
+   }
+   input_name = argv[1];
+   output_name = argv[4];
+   return simulate(argv[2]);
+}
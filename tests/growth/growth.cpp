@@ -0,0 +1,935 @@
+#include <iostream>
+#include <deque>
+#include <string.h>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <stdint.h>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+int steps = 0;
+std::string name;
+std::string input_name;
+std::string output_name;
+std::vector<char> characters;
+int width = 0;
+int height = 0;
+int depth = 0;
+size_t capacity = 0;
+inline int wrap(int i, int length) {
+    return ((i % length) + length) % length;
+}
+// Counts the offsets in list for which f holds, list being evaluated once.
+template<typename List, typename F>
+int countIf(const List &list, F f) {
+    return std::count_if(list.begin(), list.end(), f);
+}
+inline int coordinate1d(int x) {
+ return wrap(x, width);
+}
+uint64_t seed = 0;
+inline uint64_t mix(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+}
+// Draws numbers uniformly from [0, 1) for the cell (x, y, z) in generation t. Each draw is a hash of the
+// seed, generation, cell, draw and offset, so runs repeat exactly whatever the threads, tiles or shards.
+struct Dice {
+    int64_t t, x, y, z;
+    double operator()(int draw, int dx = 0, int dy = 0, int dz = 0) const {
+        uint64_t h = mix(mix(mix(mix(seed + 0x9E3779B97F4A7C15ull) ^ t) ^ x) ^ y);
+        h = mix(h ^ z);
+        h = mix(h ^ ((uint64_t) (uint16_t) draw | (uint64_t) (uint16_t) dx << 16 |
+            (uint64_t) (uint16_t) dy << 32 | (uint64_t) (uint16_t) dz << 48));
+        return (h >> 11) * 0x1.0p-53;
+    }
+};
+template<typename F>
+std::thread spawn(F f) {
+    return std::thread(f);
+}
+// Runs body(begin, end) over slabs of [0, length), a thread per slab.
+template<typename F>
+void parallel(int length, F body) {
+    int threads = std::min<int>(std::max(1u, std::thread::hardware_concurrency()), length);
+    std::vector<std::thread> pool;
+    for(int i = 0; i < threads; i++) {
+        int begin = length * i / threads;
+        int end = length * (i + 1) / threads;
+        pool.push_back(spawn([=]() {
+            body(begin, end);
+        }));
+    }
+    for(auto &thread : pool) {
+        thread.join();
+    }
+}
+const int TILE3D = 16;
+// Copies the cells opposite each face into the halo, so the padded grid wraps around.
+void wrapHalo(std::vector<uint8_t> &grid, int r) {
+    int stride = width + 2 * r;
+    size_t plane = (size_t) stride * (height + 2 * r);
+    for(int z = r; z < depth + r; z++) {
+        for(int y = r; y < height + r; y++) {
+            uint8_t *row = &grid[z * plane + y * stride];
+            for(int i = 0; i < r; i++) {
+                row[i] = row[width + i];
+                row[width + r + i] = row[r + i];
+            }
+        }
+        for(int i = 0; i < r; i++) {
+            std::copy_n(&grid[z * plane + (height + i) * stride], stride, &grid[z * plane + i * stride]);
+            std::copy_n(&grid[z * plane + (r + i) * stride], stride, &grid[z * plane + (height + r + i) * stride]);
+        }
+    }
+    for(int i = 0; i < r; i++) {
+        std::copy_n(&grid[(depth + i) * plane], plane, &grid[i * plane]);
+        std::copy_n(&grid[(r + i) * plane], plane, &grid[(depth + r + i) * plane]);
+    }
+}
+bool encodePadded(const std::vector<char> &states, std::vector<uint8_t> &grid, int r) {
+    uint8_t indices[256];
+    memset(indices, 0xFF, sizeof(indices));
+    for(int i = 0; i < (int) states.size(); i++) {
+        indices[(unsigned char) states[i]] = i;
+    }
+    int stride = width + 2 * r;
+    size_t plane = (size_t) stride * (height + 2 * r);
+    for(int z = 0; z < depth; z++) {
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                uint8_t state = indices[(unsigned char) characters[((size_t) z * height + y) * width + x]];
+                if(state == 0xFF) {
+                    return false;
+                }
+                grid[(z + r) * plane + (y + r) * stride + x + r] = state;
+            }
+        }
+    }
+    return true;
+}
+void decodePadded(const std::vector<char> &states, const std::vector<uint8_t> &grid, int r) {
+    int stride = width + 2 * r;
+    size_t plane = (size_t) stride * (height + 2 * r);
+    for(int z = 0; z < depth; z++) {
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                characters[((size_t) z * height + y) * width + x] = states[grid[(z + r) * plane + (y + r) * stride + x + r]];
+            }
+        }
+    }
+}
+// Checkpoints hold the generation reached, the seed of the dice and a byte per cell,
+// in row-major order whatever the layout.
+struct CheckpointHeader {
+    char magic[8];
+    int32_t width, height, depth, states;
+    int64_t generation;
+    uint64_t seed;
+};
+std::string checkpoint_name;
+int checkpoint_every = 0;
+std::string resume_name;
+// Writes checkpoints on a background thread, so generations carry on while they reach the disk.
+class Checkpointer {
+    std::vector<uint8_t> cells;
+    std::thread writer;
+    bool failed = false;
+    void write(int64_t generation, int states) {
+        CheckpointHeader header = {{'E', 'M', 'G', 'C', 'K', 'P', 'T', '2'}, width, height, depth, states, generation, seed};
+        // Written beside the checkpoint then renamed over it, so a crash never leaves half a checkpoint.
+        std::string temporary = checkpoint_name + ".tmp";
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if(file == NULL) {
+            failed = true;
+            return;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(cells.data(), 1, cells.size(), file) == cells.size() &&
+            fflush(file) == 0 && fsync(fileno(file)) == 0;
+        written = fclose(file) == 0 && written;
+        if(!written || rename(temporary.c_str(), checkpoint_name.c_str()) != 0) {
+            failed = true;
+        }
+    }
+  public:
+    ~Checkpointer() {
+        finish();
+    }
+    // Copies every cell(x, y, z) and writes them once the previous checkpoint is written.
+    template<typename F>
+    bool save(int64_t generation, int states, F cell) {
+        if(!finish()) {
+            return false;
+        }
+        cells.resize((size_t) width * height * depth);
+        size_t i = 0;
+        for(int z = 0; z < depth; z++) {
+            for(int y = 0; y < height; y++) {
+                for(int x = 0; x < width; x++) {
+                    cells[i++] = cell(x, y, z);
+                }
+            }
+        }
+        writer = spawn([=]() {
+            write(generation, states);
+        });
+        return true;
+    }
+    // Waits for the checkpoint being written, returning whether every checkpoint was written.
+    bool finish() {
+        if(writer.joinable()) {
+            writer.join();
+        }
+        return !failed;
+    }
+};
+// Maps the checkpoint to resume from, checking it was taken of a grid like this one.
+class Resumed {
+    void *map = MAP_FAILED;
+    size_t length = 0;
+  public:
+    const char *error = "";
+    int64_t generation = 0;
+    const uint8_t *cells = nullptr;
+    Resumed(int states) {
+        int fd = ::open(resume_name.c_str(), O_RDONLY);
+        struct stat info;
+        if(fd < 0 || fstat(fd, &info) != 0) {
+            error = "Error: Unable to open the checkpoint to resume.";
+            if(fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+        length = info.st_size;
+        size_t expected = sizeof(CheckpointHeader) + (size_t) width * height * depth;
+        if(length == expected) {
+            map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if(map == MAP_FAILED) {
+            error = "Error: The checkpoint does not match INPUT.";
+            return;
+        }
+        const CheckpointHeader *header = (const CheckpointHeader *) map;
+        if(memcmp(header->magic, "EMGCKPT2", 8) != 0 || header->width != width || header->height != height ||
+                header->depth != depth || header->states != states || header->generation > steps) {
+            error = "Error: The checkpoint does not match INPUT.";
+            return;
+        }
+        generation = header->generation;
+        // Resumed runs carry on drawing from the dice they were checkpointed with.
+        seed = header->seed;
+        cells = (const uint8_t *) map + sizeof(CheckpointHeader);
+        for(size_t i = 0; i < length - sizeof(CheckpointHeader); i++) {
+            if(cells[i] >= states) {
+                error = "Error: Unrecognised state within the checkpoint.";
+                return;
+            }
+        }
+    }
+    ~Resumed() {
+        if(map != MAP_FAILED) {
+            munmap(map, length);
+        }
+    }
+    uint8_t operator()(int x, int y, int z) const {
+        return cells[((size_t) z * height + y) * width + x];
+    }
+};
+// Frames are written every frame_every generations, to frame_pattern with its #s replaced by the generation,
+// as binary PPM if it ends in .ppm, as PNG if it ends in .png, otherwise as text.
+std::string frame_pattern;
+int frame_every = 0;
+// Frames hold the region_width by region_height cells from (region_x, region_y), or all of them if 0,
+// each block of downsample by downsample cells drawn as its most common state, or its density if set.
+int region_x = 0;
+int region_y = 0;
+int region_width = 0;
+int region_height = 0;
+int downsample = 1;
+bool density = false;
+// Names the frame of a generation, zero padding it to the length of the run of #s.
+std::string frameName(int64_t generation) {
+    size_t end = frame_pattern.find_last_of('#') + 1;
+    size_t begin = frame_pattern.find_last_not_of('#', end - 1) + 1;
+    std::string number = std::to_string(generation);
+    if(number.size() < end - begin) {
+        number = std::string(end - begin - number.size(), '0') + number;
+    }
+    return frame_pattern.substr(0, begin) + number + frame_pattern.substr(end);
+}
+void putBigEndian(std::string &bytes, uint32_t n) {
+    for(int shift = 24; shift >= 0; shift -= 8) {
+        bytes += (char) (n >> shift);
+    }
+}
+// CRC-32 of bytes from begin, as PNG chunks end with.
+uint32_t pngCrc(const std::string &bytes, size_t begin) {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> table;
+        for(uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }();
+    uint32_t c = 0xFFFFFFFFu;
+    for(size_t i = begin; i < bytes.size(); i++) {
+        c = table[(c ^ (unsigned char) bytes[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+// Encodes w by h RGB pixels as PNG, in deflate blocks left uncompressed so that no library is needed.
+std::string encodePng(const std::vector<uint8_t> &rgb, int w, int h) {
+    // Each scanline is led by its filter, 0 for none.
+    std::string raw;
+    raw.reserve((size_t) (w * 3 + 1) * h);
+    for(int y = 0; y < h; y++) {
+        raw += '\0';
+        raw.append((const char *) &rgb[(size_t) y * w * 3], (size_t) w * 3);
+    }
+    std::string data = "\x78\x01";
+    for(size_t i = 0; i < raw.size(); i += 65535) {
+        size_t n = std::min<size_t>(65535, raw.size() - i);
+        data += (char) (i + n == raw.size());
+        data += (char) n;
+        data += (char) (n >> 8);
+        data += (char) ~n;
+        data += (char) (~n >> 8);
+        data.append(raw, i, n);
+    }
+    // Adler-32, reduced only as often as its sums could overflow.
+    uint32_t a = 1, b = 0;
+    for(size_t i = 0; i < raw.size(); i += 5552) {
+        for(size_t j = i; j < std::min(raw.size(), i + 5552); j++) {
+            a += (unsigned char) raw[j];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    putBigEndian(data, b << 16 | a);
+    std::string png = "\x89PNG\r\n\x1A\n";
+    auto chunk = [&](const char *type, const std::string &body) {
+        putBigEndian(png, body.size());
+        size_t begin = png.size();
+        png += type;
+        png += body;
+        putBigEndian(png, pngCrc(png, begin));
+    };
+    std::string header;
+    putBigEndian(header, w);
+    putBigEndian(header, h);
+    header += std::string("\x08\x02\x00\x00\x00", 5);
+    chunk("IHDR", header);
+    chunk("IDAT", data);
+    chunk("IEND", "");
+    return png;
+}
+// Writes a frame of the states in view, or their densities in percent, columns by rows a layer.
+bool writeFrame(int64_t generation, const std::vector<uint8_t> &view, int columns, int rows,
+        const std::vector<char> &states, const std::vector<uint32_t> &colours) {
+    std::string name = frameName(generation);
+    bool ppm = name.size() >= 4 && name.compare(name.size() - 4, 4, ".ppm") == 0;
+    bool png = name.size() >= 4 && name.compare(name.size() - 4, 4, ".png") == 0;
+    std::string bytes;
+    if(ppm || png) {
+        // Each pixel is copied as four bytes of the palette, the fourth overwritten by the next pixel,
+        // so the lookup is a load and a store whatever the colour.
+        uint8_t palette[256][4] = {};
+        for(int i = 0; i < 256; i++) {
+            uint32_t colour = density ? (std::min(i, 100) * 255 / 100) * 0x010101u : i < (int) colours.size() ? colours[i] : 0;
+            palette[i][0] = colour >> 16;
+            palette[i][1] = colour >> 8;
+            palette[i][2] = colour;
+        }
+        std::vector<uint8_t> rgb(view.size() * 3 + 1);
+        for(size_t i = 0; i < view.size(); i++) {
+            memcpy(&rgb[i * 3], palette[view[i]], 4);
+        }
+        rgb.pop_back();
+        // Layers of a 3D grid are stacked down the image.
+        if(ppm) {
+            bytes = "P6\n" + std::to_string(columns) + " " + std::to_string(rows * depth) + "\n255\n";
+            bytes.append((const char *) rgb.data(), rgb.size());
+        } else {
+            bytes = encodePng(rgb, columns, rows * depth);
+        }
+    } else {
+        bytes.reserve(view.size() + (size_t) rows * depth + depth);
+        for(size_t i = 0; i < view.size(); i++) {
+            if(i > 0 && i % ((size_t) columns * rows) == 0) {
+                bytes += '\n';
+            }
+            bytes += density ? (char) ('0' + std::min(9, view[i] / 10)) : states[view[i]];
+            if((i + 1) % columns == 0) {
+                bytes += '\n';
+            }
+        }
+    }
+    FILE *file = fopen(name.c_str(), "wb");
+    if(file == NULL) {
+        return false;
+    }
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && written;
+}
+// Draws frames as the grid is simulated, writing them on a background thread as checkpoints are.
+class Framer {
+    std::vector<uint8_t> view;
+    std::thread writer;
+    bool failed = false;
+  public:
+    ~Framer() {
+        finish();
+    }
+    // Draws the region of the grid through cell(x, y, z), reading only the cells within it,
+    // and writes it once the previous frame is written.
+    template<typename F>
+    bool save(int64_t generation, const std::vector<char> &states, const std::vector<uint32_t> &colours,
+            uint8_t background, F cell) {
+        if(!finish()) {
+            return false;
+        }
+        int w = region_width > 0 ? region_width : width;
+        int h = region_height > 0 ? region_height : height;
+        int columns = (w + downsample - 1) / downsample;
+        int rows = (h + downsample - 1) / downsample;
+        view.resize((size_t) columns * rows * depth);
+        std::vector<int> counts(states.size());
+        size_t i = 0;
+        for(int z = 0; z < depth; z++) {
+            for(int row = 0; row < rows; row++) {
+                for(int column = 0; column < columns; column++) {
+                    std::fill(counts.begin(), counts.end(), 0);
+                    int y_end = std::min(h, (row + 1) * downsample);
+                    int x_end = std::min(w, (column + 1) * downsample);
+                    for(int y = row * downsample; y < y_end; y++) {
+                        for(int x = column * downsample; x < x_end; x++) {
+                            counts[cell(wrap(region_x + x, width), wrap(region_y + y, height), z)]++;
+                        }
+                    }
+                    if(density) {
+                        // The percentage of the block outside the background state.
+                        int cells = (y_end - row * downsample) * (x_end - column * downsample);
+                        view[i++] = (cells - counts[background]) * 100 / cells;
+                    } else {
+                        view[i++] = std::max_element(counts.begin(), counts.end()) - counts.begin();
+                    }
+                }
+            }
+        }
+        writer = spawn([=]() {
+            failed = !writeFrame(generation, view, columns, rows, states, colours);
+        });
+        return true;
+    }
+    // Waits for the frame being written, returning whether every frame was written.
+    bool finish() {
+        if(writer.joinable()) {
+            writer.join();
+        }
+        return !failed;
+    }
+};
+bool map_output = false;
+// Writes OUTPUT a row at a time, each layer of a 3D grid followed by a blank line but the last.
+bool writeOutput() {
+    size_t row = width + 1;
+    size_t layer = (size_t) height * row + 1;
+    size_t length = characters.empty() ? 0 : depth * layer - 1;
+    if(map_output && length > 0) {
+        // Rows are copied straight into the mapped file, by as many threads as there are cores.
+        int fd = ::open(output_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0 || ftruncate(fd, length) != 0) {
+            if(fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+        char *text = (char *) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(text == MAP_FAILED) {
+            return false;
+        }
+        parallel(depth * height, [&](int begin, int end) {
+            for(int r = begin; r < end; r++) {
+                char *out = text + (r / height) * layer + (r % height) * row;
+                memcpy(out, &characters[(size_t) r * width], width);
+                out[width] = '\n';
+                if(r % height == height - 1 && r < depth * height - 1) {
+                    out[width + 1] = '\n';
+                }
+            }
+        });
+        return munmap(text, length) == 0;
+    }
+    FILE *output = fopen(output_name.c_str(), "w");
+    if(output == NULL) {
+        return false;
+    }
+    std::vector<char> text(row);
+    text[width] = '\n';
+    bool written = true;
+    for(int r = 0; r < depth * height && written; r++) {
+        if(r > 0 && r % height == 0) {
+            written = putc('\n', output) != EOF;
+        }
+        memcpy(text.data(), &characters[(size_t) r * width], width);
+        written = written && fwrite(text.data(), 1, row, output) == row;
+    }
+    return fclose(output) == 0 && written;
+}
+// Reads a grid of characters, layers of a 3D grid separated by blank lines, keeping them if store is set.
+const char* readDense(FILE *input, bool store) {
+    int pos = 0;
+    int rows = 0;
+    int c;
+    do {
+        c = getc(input);
+        if(c == '\r') {
+            continue;
+        }
+        if(c != '\n' && c != EOF) {
+            if(store) {
+                characters.push_back(c);
+            }
+            pos++;
+            continue;
+        }
+        bool blank = pos == 0;
+        if(!blank) {
+            if(width == 0) {
+                width = pos;
+            } else if(pos != width) {
+                return "Error: Contradicing dimensions within INPUT file.";
+            }
+            rows++;
+            pos = 0;
+        }
+        if((blank || c == EOF) && rows > 0) {
+            if(depth == 0) {
+                height = rows;
+            } else if(rows != height) {
+                return "Error: Contradicing dimensions within INPUT file.";
+            }
+            depth++;
+            rows = 0;
+        }
+    } while(c != EOF);
+    return "";
+}
+// Files ending in .rle hold run-length encoded patterns, as in Life RLE.
+bool isRle(const std::string &file) {
+    return file.size() > 4 && file.compare(file.size() - 4, 4, ".rle") == 0;
+}
+// RLE tags name the default state b or ., and the other states o or A, B, ... up to pX,
+// in the order of the palette, which holds the characters of the default state then the others.
+int rleTag(int prefix, int c) {
+    if(c == 'b' || c == '.') {
+        return 0;
+    }
+    if(c == 'o') {
+        return 1;
+    }
+    if(c >= 'A' && c <= 'X') {
+        return (prefix == 0 ? 0 : (prefix - 'p' + 1) * 24) + c - 'A' + 1;
+    }
+    return -1;
+}
+const char* readRle(FILE *input, const std::string &palette) {
+    if(palette == "") {
+        return "Error: Incorrect 2nd operand MODEL must be a name of a model";
+    }
+    int c;
+    // Comments precede the header, which gives the dimensions of the grid.
+    while((c = getc(input)) == '#') {
+        while((c = getc(input)) != '\n' && c != EOF);
+    }
+    ungetc(c, input);
+    if(fscanf(input, " x = %d , y = %d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        return "Error: Missing the header of the RLE INPUT.";
+    }
+    while((c = getc(input)) != '\n' && c != EOF);
+    depth = 1;
+    characters.assign((size_t) width * height, palette[0]);
+    int x = 0, y = 0, count = 0, prefix = 0;
+    while((c = getc(input)) != EOF && c != '!') {
+        if(c >= '0' && c <= '9') {
+            count = count * 10 + c - '0';
+            continue;
+        }
+        if(c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            continue;
+        }
+        if(c >= 'p' && c <= 'y') {
+            prefix = c;
+            continue;
+        }
+        int run = std::max(count, 1);
+        count = 0;
+        if(c == '$') {
+            y += run;
+            x = 0;
+            continue;
+        }
+        int state = rleTag(prefix, c);
+        prefix = 0;
+        if(state < 0 || state >= (int) palette.size()) {
+            return "Error: Unrecognised state within INPUT.";
+        }
+        if(x + run > width || y >= height) {
+            return "Error: The RLE INPUT overflows its dimensions.";
+        }
+        if(state != 0) {
+            memset(&characters[(size_t) y * width + x], palette[state], run);
+        }
+        x += run;
+    }
+    return "";
+}
+// Writes OUTPUT as RLE, a run at a time, leaving out the default state at the ends of rows.
+bool writeRle(const std::string &palette) {
+    std::string tags[256];
+    for(int i = 0; i < (int) palette.size(); i++) {
+        if(palette.size() <= 2) {
+            tags[(unsigned char) palette[i]] = i == 0 ? "b" : "o";
+        } else if(i == 0) {
+            tags[(unsigned char) palette[i]] = ".";
+        } else {
+            int prefix = (i - 1) / 24;
+            tags[(unsigned char) palette[i]] = (prefix > 0 ? std::string(1, 'p' + prefix - 1) : "") + std::string(1, 'A' + (i - 1) % 24);
+        }
+    }
+    FILE *output = fopen(output_name.c_str(), "w");
+    if(output == NULL) {
+        return false;
+    }
+    fprintf(output, "x = %d, y = %d\n", width, height);
+    // Lines are kept within 70 characters, as is conventional.
+    std::string line;
+    auto emit = [&](int run, const std::string &tag) {
+        std::string item = (run > 1 ? std::to_string(run) : "") + tag;
+        if(line.size() + item.size() > 70) {
+            fprintf(output, "%s\n", line.c_str());
+            line.clear();
+        }
+        line += item;
+    };
+    int ends = 0;
+    for(int y = 0; y < height; y++) {
+        const char *row = &characters[(size_t) y * width];
+        int end = width;
+        while(end > 0 && row[end - 1] == palette[0]) {
+            end--;
+        }
+        ends += y > 0;
+        if(end == 0) {
+            continue;
+        }
+        if(ends > 0) {
+            emit(ends, "$");
+            ends = 0;
+        }
+        for(int x = 0; x < end;) {
+            int run = 1;
+            while(x + run < end && row[x + run] == row[x]) {
+                run++;
+            }
+            emit(run, tags[(unsigned char) row[x]]);
+            x += run;
+        }
+    }
+    emit(1, "!");
+    fprintf(output, "%s\n", line.c_str());
+    return fclose(output) == 0;
+}
+size_t coordinate2d(std::pair<int,int> p) {
+    return wrap(p.first, width) + ((size_t) width * wrap(p.second, height));
+};
+void layout() {
+    capacity = (size_t) width * height;
+}
+template<int BITS>
+class Grid {
+    static const int PER_BYTE = 8 / BITS;
+    static const uint8_t MASK = (1 << BITS) - 1;
+    std::vector<uint8_t> bytes;
+    size_t cells;
+  public:
+    Grid(size_t cells) : bytes((cells + PER_BYTE - 1) / PER_BYTE), cells(cells) {};
+    size_t size() const {
+        return cells;
+    }
+    // Clears the grid to hold the given number of cells, reusing its bytes.
+    void reset(size_t cells) {
+        bytes.assign((cells + PER_BYTE - 1) / PER_BYTE, 0);
+        this->cells = cells;
+    }
+    uint8_t operator[](size_t i) const {
+        return (bytes[i / PER_BYTE] >> ((i % PER_BYTE) * BITS)) & MASK;
+    }
+    const std::vector<uint8_t> &data() const {
+        return bytes;
+    }
+    void set(size_t i, uint8_t state) {
+        uint8_t &byte = bytes[i / PER_BYTE];
+        int shift = (i % PER_BYTE) * BITS;
+        byte = (byte & ~(MASK << shift)) | (state << shift);
+    }
+};
+// Reads cells relative to (x, y), wrapping around the edges of the grid.
+template<typename G>
+struct Wrapped {
+    const G &grid;
+    int x, y;
+    size_t current;
+    uint8_t centre() const {
+        return grid[current];
+    }
+    uint8_t operator()(int dx) const {
+        return grid[coordinate1d(x + dx)];
+    }
+    uint8_t operator()(int dx, int dy) const {
+        return grid[coordinate2d({x + dx, y + dy})];
+    }
+};
+// Reads cells relative to current, within unpacked cells with the given row and plane strides.
+struct Local {
+    const uint8_t *cells;
+    int stride;
+    int64_t plane, current;
+    uint8_t centre() const {
+        return cells[current];
+    }
+    uint8_t operator()(int dx) const {
+        return cells[current + dx];
+    }
+    uint8_t operator()(int dx, int dy) const {
+        return cells[current + dy * stride + dx];
+    }
+    uint8_t operator()(int dx, int dy, int dz) const {
+        return cells[current + dz * plane + dy * stride + dx];
+    }
+};
+template<int BITS>
+bool encode(const std::vector<char> &states, Grid<BITS> &grid) {
+    uint8_t indices[256];
+    memset(indices, 0xFF, sizeof(indices));
+    for(int i = 0; i < (int) states.size(); i++) {
+        indices[(unsigned char) states[i]] = i;
+    }
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            uint8_t state = indices[(unsigned char) characters[(size_t) y * width + x]];
+            if(state == 0xFF) {
+                return false;
+            }
+            grid.set(coordinate2d({x,y}), state);
+        }
+    }
+    return true;
+}
+template<int BITS>
+void decode(const std::vector<char> &states, const Grid<BITS> &grid) {
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            characters[(size_t) y * width + x] = states[grid[coordinate2d({x,y})]];
+        }
+    }
+}
+constexpr std::array<std::array<int,3>, 6> faces = {{
+   {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}
+}};
+template<typename Cells>
+uint8_t growth_rule(const Cells &cells, const Dice &dice) {
+    if(((cells.centre() == 1) || (countIf(faces, [&](std::array<int, 3> cell) { return(cells(cell[0], cell[1], cell[2]) == 1);}) == 1))) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+const char* growth() {
+   const std::vector<char> states = {'.', '#'};
+   const std::vector<uint32_t> colours = {0, 16777215};
+   const int r = 1;
+   if(width < r || height < r || depth < r) {
+       return "Error: INPUT is narrower than the radius of the neighbourhood.";
+   }
+   int stride = width + 2 * r;
+   int64_t plane = (int64_t) stride * (height + 2 * r);
+   std::vector<uint8_t> prev(plane * (depth + 2 * r));
+   std::vector<uint8_t> next(prev.size());
+   if(!encodePadded(states, prev, r)) {
+       return "Error: Unrecognised state within INPUT.";
+   }
+   int t = 0;
+   if(resume_name != "") {
+       Resumed resumed(states.size());
+       if(*resumed.error) {
+           return resumed.error;
+       }
+       t = resumed.generation;
+       for(int z = 0; z < depth; z++) {
+           for(int y = 0; y < height; y++) {
+               for(int x = 0; x < width; x++) {
+                   prev[(z + r) * plane + (y + r) * stride + x + r] = resumed(x, y, z);
+               }
+           }
+       }
+   }
+   Checkpointer checkpointer;
+   Framer framer;
+   const uint8_t background = 0;
+   wrapHalo(prev, r);
+   for(; t < steps; t++) {
+       // Each thread sweeps a slab of layers, a tile of rows at a time.
+       parallel(depth, [&](int z_begin, int z_end) {
+           for(int ty = 0; ty < height; ty += TILE3D) {
+           for(int z = z_begin; z < z_end; z++) {
+           for(int y = ty; y < std::min(ty + TILE3D, height); y++) {
+               int64_t row = (z + r) * plane + (y + r) * stride + r;
+               for(int x = 0; x < width; x++) {
+                   int64_t current = row + x;
+                   next[current] = growth_rule(Local{prev.data(), stride, plane, current}, Dice{t, x, y, z});
+               }
+           }
+           }
+           }
+       });
+       std::swap(next, prev);
+       wrapHalo(prev, r);
+       if(checkpoint_every > 0 && (t + 1) / checkpoint_every > t / checkpoint_every &&
+               !checkpointer.save((t + 1), states.size(), [&](int x, int y, int z) { return prev[(z + r) * plane + (y + r) * stride + x + r]; })) {
+           return "Error: Unable to write a checkpoint.";
+       }
+       if(frame_every > 0 && (t + 1) / frame_every > t / frame_every &&
+               !framer.save((t + 1), states, colours, background, [&](int x, int y, int z) { return prev[(z + r) * plane + (y + r) * stride + x + r]; })) {
+           return "Error: Unable to write a frame.";
+       }
+   }
+   if(!checkpointer.finish()) {
+       return "Error: Unable to write a checkpoint.";
+   }
+   if(!framer.finish()) {
+       return "Error: Unable to write a frame.";
+   }
+   decodePadded(states, prev, r);
+   return "";
+}
+std::string palette(const std::string &model) {
+    if(model == "growth") {
+        return ".#";
+    }
+    return "";
+}
+int simulate(const std::string &model) {
+   width = 0;
+   height = 0;
+   depth = 0;
+   characters.clear();
+   FILE *input = fopen(input_name.c_str(), "r");
+   if(input == NULL) {
+       perror("Error: Unable to open input file.\n");
+       return 1;
+   }
+   std::string read = isRle(input_name) ? readRle(input, palette(model)) : readDense(input, true);
+   fclose(input);
+   if(read != "") {
+       std::cout << read + "\n";
+       return 1;
+   }
+   // RLE holds a single layer, so 3D grids are rejected before they are simulated.
+   if(depth > 1 && isRle(output_name)) {
+       std::cout << "Error: RLE OUTPUT holds only 1D and 2D grids.\n";
+       return 1;
+   }
+   layout();
+   std::string error;
+    if(model == "growth") {
+       if((error = growth()) != "") {
+           std::cout << error + "\n";
+           return 1;
+       }
+   } else  {
+       std::cout << "Error: Incorrect 2nd operand MODEL must be a name of a model\n";
+       return 1;
+   }
+   if(!(isRle(output_name) ? writeRle(palette(model)) : writeOutput())) {
+       perror("Error: Unable to write output file.\n");
+       return 1;
+   }
+   return 0;
+}
+int main(int argc, char **argv) {
+   name = std::string(argv[0]);
+   if(argc < 5) {
+   std::cout << "Error: Missing operands\nUsage: ./" +  name + " INPUT MODEL STEPS OUTPUT [OPTION]...\n";   return 1;
+   }
+   steps = std::atoi(argv[3]);
+   if(steps == 0) {
+       std::cout << "Error: Incorrect 3rd operand STEPS must be > 0\n";
+       return 1;
+   }
+   for(int i = 5; i < argc; i++) {
+       std::string option(argv[i]);
+       if(option == "--map-output") {
+           map_output = true;
+       } else if(option == "--checkpoint" && i + 2 < argc) {
+           checkpoint_name = argv[++i];
+           checkpoint_every = std::atoi(argv[++i]);
+           if(checkpoint_every < 1) {
+               std::cout << "Error: --checkpoint expects EVERY > 0\n";
+               return 1;
+           }
+       } else if(option == "--resume" && i + 1 < argc) {
+           resume_name = argv[++i];
+       } else if(option == "--seed" && i + 1 < argc) {
+           seed = strtoull(argv[++i], NULL, 10);
+       } else if(option == "--frames" && i + 2 < argc) {
+           frame_pattern = argv[++i];
+           frame_every = std::atoi(argv[++i]);
+           if(frame_every < 1 || frame_pattern.find('#') == std::string::npos) {
+               std::cout << "Error: --frames expects a PATTERN containing # and EVERY > 0\n";
+               return 1;
+           }
+       } else if(option == "--region" && i + 1 < argc) {
+           if(sscanf(argv[++i], "%d,%d,%dx%d", &region_x, &region_y, &region_width, &region_height) != 4 ||
+                   region_width < 1 || region_height < 1) {
+               std::cout << "Error: --region expects X,Y,WxH\n";
+               return 1;
+           }
+       } else if((option == "--downsample" || option == "--density") && i + 1 < argc) {
+           downsample = std::atoi(argv[++i]);
+           density = option == "--density";
+           if(downsample < 1) {
+               std::cout << "Error: " + option + " expects N > 0\n";
+               return 1;
+           }
+       } else {
+           std::cout << "Error: Unknown option " + option + "\n";
+           return 1;
+       }
+   }
+   input_name = argv[1];
+   output_name = argv[4];
+   return simulate(argv[2]);
+}
@@ -17,8 +17,175 @@ cd tests/game_of_life/
 rm -rf ./*.out
 pwd
 $DIR/bin/emergent ./game_of_life.emg
-$CLANG ./game_of_life.cpp -o game_of_life
-./game_of_life example.txt conway 4 example.txt
+$CLANG ./game_of_life.cpp -pthread -o game_of_life
+./game_of_life example.txt conway 4 example.out
+./game_of_life example.txt conway 20 plain.out
+
+# Runs resumed from a checkpoint write the same grid as one run through.
+./game_of_life example.txt conway 12 checkpointed.out --checkpoint checkpoint.out 5
+./game_of_life example.txt conway 20 resumed.out --resume checkpoint.out
+cmp plain.out resumed.out
+
+# Grids written as RLE and read back continue as if never written.
+./game_of_life example.txt conway 10 half.rle
+./game_of_life half.rle conway 10 rle.out
+cmp plain.out rle.out
+rm half.rle
+
+# Statistics count each state and bound the live cells every generation.
+$DIR/bin/emergent -a ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_stats
+./game_of_life_stats example.txt conway 20 gathered.out --stats gathered.csv
+cmp plain.out gathered.out
+cmp stats.csv gathered.csv
+rm gathered.csv
+
+# Cycles are not skipped whilst frames are written, so a still life is drawn every generation.
+$DIR/bin/emergent -c ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_cycles
+./game_of_life_cycles still.txt conway 20 still.out --frames frame_##.out 1
+test $(ls frame_*.out | wc -l) -eq 20
+cmp still.out frame_20.out
+
+# Without frames, cycles are skipped, yet the grid reached after STEPS is the same as when simulated through.
+./game_of_life still.txt conway 1000 still_plain.out
+./game_of_life_cycles still.txt conway 1000 still_cycles.out
+cmp still_plain.out still_cycles.out
+./game_of_life example.txt conway 1000 long.out
+./game_of_life_cycles example.txt conway 1000 cycles.out
+cmp long.out cycles.out
+
+# Blocks write the same grid as one generation at a time, with frames and checkpoints where asked for.
+$DIR/bin/emergent -b ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_blocks
+./game_of_life example.txt conway 20 framed.out --frames framed_##.out 5 --checkpoint framed_checkpoint.out 5
+./game_of_life_blocks example.txt conway 20 blocks.out --frames blocks_##.out 5 --checkpoint blocks_checkpoint.out 5
+cmp plain.out blocks.out
+for generation in 05 10 15 20; do
+  cmp framed_$generation.out blocks_$generation.out
+done
+cmp framed_checkpoint.out blocks_checkpoint.out
+./game_of_life example.txt conway 21 framed.out --frames region_##.out 7 --region 3,4,20x15 --density 3
+./game_of_life_blocks example.txt conway 21 blocks.out --frames blocks_region_##.out 7 --region 3,4,20x15 --density 3
+for generation in 07 14 21; do
+  cmp region_$generation.out blocks_region_$generation.out
+done
+
+# Batches write the same grids as their jobs run one by one, and list each job as done.
+$DIR/bin/emergent -m ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_batch
+./game_of_life_batch manifest.txt conway 20 summary.out --batch
+./game_of_life example.out conway 20 single.out
+cmp plain.out batch_a.out
+cmp single.out batch_b.out
+printf 'example.txt batch_a.out ok\nexample.out batch_b.out ok\n' | cmp - summary.out
+
+# Shards, whether launched together or one by one, write the same grid as a single process.
+$DIR/bin/emergent -s ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_shards
+./game_of_life_shards example.txt conway 20 shards.out --shards 3
+cmp plain.out shards.out
+./game_of_life_shards example.txt conway 20 shard.out --shard 0/2 test_$$ &
+./game_of_life_shards example.txt conway 20 shard.out --shard 1/2 test_$$
+wait $!
+cmp plain.out shard.out
+
+# Grids streamed through scratch files write the same grid as one held in memory.
+$DIR/bin/emergent -o ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_stream
+./game_of_life_stream example.txt conway 20 stream.out --stream .
+cmp plain.out stream.out
+
+# Each instance of an ensemble writes the same grid as it would alone.
+$DIR/bin/emergent -e ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_ensemble
+{ cat example.txt; echo; cat example.txt; } > layers.txt
+./game_of_life_ensemble layers.txt conway 20 ensemble.out --ensemble
+{ cat plain.out; echo; cat plain.out; } | cmp - ensemble.out
+rm layers.txt
+
+# Predicates compiled into decision diagrams write the same grid as those evaluated directly.
+$DIR/bin/emergent -d ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_decided
+./game_of_life_decided example.txt conway 20 decided.out
+cmp plain.out decided.out
+
+# Grids stored in Z-order write the same grid as those stored row by row.
+$DIR/bin/emergent -z ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_morton
+./game_of_life_morton example.txt conway 20 morton.out
+cmp plain.out morton.out
+
+# An unbounded glider grows as it would amid a bounded grid padded beyond its reach, once both are trimmed to the live cells.
+$DIR/bin/emergent -u ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_unbounded
+printf -- '-@---\n--@--\n@@@--\n' > glider.txt
+awk 'function dashes(n, s) { s = sprintf("%" n "s", ""); gsub(/ /, "-", s); return s }
+  { rows[NR] = $0 }
+  END {
+    for(i = 0; i < 12; i++) print dashes(length(rows[1]) + 24)
+    for(i = 1; i <= NR; i++) print dashes(12) rows[i] dashes(12)
+    for(i = 0; i < 12; i++) print dashes(length(rows[1]) + 24)
+  }' glider.txt > padded.txt
+./game_of_life_unbounded glider.txt conway 10 unbounded.out --unbounded
+./game_of_life padded.txt conway 10 padded.out
+TRIM='{ rows[NR] = $0; l = index($0, "@"); if(l) { if(!top) top = NR; bottom = NR; if(!left || l < left) left = l; r = match($0, /@[^@]*$/); if(r > right) right = r } }
+  END { for(i = top; i <= bottom; i++) print substr(rows[i], left, right - left + 1) }'
+awk "$TRIM" padded.out | cmp - <(awk "$TRIM" unbounded.out)
+rm glider.txt padded.txt
+
+# Sweeps specialised for the size of example.txt write the same grid, as do those falling back for other sizes.
+$DIR/bin/emergent --size 40x33 ./game_of_life.emg
+$CLANG ./game_of_life.cpp -pthread -o game_of_life_sized
+./game_of_life_sized example.txt conway 20 sized.out
+cmp plain.out sized.out
+./game_of_life_sized still.txt conway 1000 still_sized.out
+cmp still_plain.out still_sized.out
+
+# Simulators split into units, built through their makefile, write the same grid as one unit.
+rm -rf split
+mkdir split
+cp game_of_life.emg split/
+$DIR/bin/emergent --split split/game_of_life.emg
+make -s -j -C split -f game_of_life.mk CXX=$CLANG
+split/game_of_life example.txt conway 20 split.out
+cmp plain.out split.out
+rm -rf split
+
+# Simulators linked against the prebuilt runtime write the same grid as those carrying their own.
+make -s -C $DIR runtime
+$DIR/bin/emergent -l ./game_of_life.emg
+$CLANG ./game_of_life.cpp -I $DIR/bin $DIR/bin/libemergent.a -pthread -o game_of_life_linked
+./game_of_life_linked example.txt conway 20 linked.out
+cmp plain.out linked.out
+
+# Frames drawn as PPM and as PNG hold the same pixels, dark wherever the text frame is dead.
+./game_of_life example.txt conway 20 drawn.out --frames drawn_##.out 10
+./game_of_life example.txt conway 20 drawn.out --frames drawn_##.ppm 10
+./game_of_life example.txt conway 20 drawn.out --frames drawn_##.png 10
+head -c 13 drawn_20.ppm | cmp - <(printf 'P6\n40 33\n255\n')
+python3 - drawn_20.png drawn_20.ppm drawn_20.out <<'EOF'
+import struct, sys, zlib
+png = open(sys.argv[1], 'rb').read()
+assert png[:8] == b'\x89PNG\r\n\x1a\n'
+chunks, i = {}, 8
+while i < len(png):
+    length, = struct.unpack('>I', png[i:i + 4])
+    kind, body = png[i + 4:i + 8], png[i + 8:i + 8 + length]
+    assert struct.unpack('>I', png[i + 8 + length:i + 12 + length])[0] == zlib.crc32(kind + body)
+    chunks[kind] = chunks.get(kind, b'') + body
+    i += 12 + length
+assert list(chunks) == [b'IHDR', b'IDAT', b'IEND']
+width, height = struct.unpack('>II', chunks[b'IHDR'][:8])
+raw = zlib.decompress(chunks[b'IDAT'])
+assert len(raw) == (width * 3 + 1) * height and all(raw[y * (width * 3 + 1)] == 0 for y in range(height))
+rgb = b''.join(raw[y * (width * 3 + 1) + 1:(y + 1) * (width * 3 + 1)] for y in range(height))
+assert open(sys.argv[2], 'rb').read() == b'P6\n%d %d\n255\n' % (width, height) + rgb
+cells = open(sys.argv[3]).read().split()
+assert [len(row) for row in cells] == [width] * height
+assert all((rgb[(y * width + x) * 3:(y * width + x) * 3 + 3] == b'\0\0\0') == (cells[y][x] == '-')
+    for y in range(height) for x in range(width))
+EOF
 
 cd ../../
 
@@ -26,7 +193,9 @@ cd tests/rule_thirty/
 rm -rf ./*.out
 pwd
 $DIR/bin/emergent ./rule_thirty.emg
-$CLANG ./rule_thirty.cpp -o rule_thirty
+$CLANG ./rule_thirty.cpp -pthread -o rule_thirty
+./rule_thirty example.txt rule_thirty 15 example.out
+cmp expected.txt example.out
 
 cd ../../
 
@@ -34,7 +203,9 @@ cd tests/wireworld/
 rm -rf ./*.out
 pwd
 $DIR/bin/emergent ./wireworld.emg
-$CLANG ./wireworld.cpp -o wireworld
+$CLANG ./wireworld.cpp -pthread -o wireworld
+./wireworld example.txt wireworld 6 example.out
+cmp expected.txt example.out
 
 cd ../../
 
@@ -42,6 +213,52 @@ cd tests/waves/
 rm -rf ./*.out
 pwd
 $DIR/bin/emergent ./waves.emg
-$CLANG ./waves.cpp -o waves
+$CLANG ./waves.cpp -pthread -o waves
+./waves example.txt waves 8 example.out
+cmp expected.txt example.out
+
+cd ../../
+
+cd tests/growth/
+rm -rf ./*.out
+pwd
+$DIR/bin/emergent ./growth.emg
+$CLANG ./growth.cpp -pthread -o growth
+./growth example.txt growth 4 example.out
+cmp expected.txt example.out
+
+cd ../../
+
+cd tests/forest_fire/
+rm -rf ./*.out
+pwd
+$DIR/bin/emergent ./forest_fire.emg
+$CLANG ./forest_fire.cpp -pthread -o forest_fire
+./forest_fire example.txt forest_fire 10 example.out --seed 7
+cmp expected.txt example.out
+
+# Draws are keyed on the cell and generation, so every engine writes the same grid for a seed.
+$DIR/bin/emergent -b ./forest_fire.emg
+$CLANG ./forest_fire.cpp -pthread -o forest_fire_blocks
+./forest_fire_blocks example.txt forest_fire 10 blocks.out --seed 7
+cmp expected.txt blocks.out
+$DIR/bin/emergent -z ./forest_fire.emg
+$CLANG ./forest_fire.cpp -pthread -o forest_fire_morton
+./forest_fire_morton example.txt forest_fire 10 morton.out --seed 7
+cmp expected.txt morton.out
+$DIR/bin/emergent -s ./forest_fire.emg
+$CLANG ./forest_fire.cpp -pthread -o forest_fire_shards
+./forest_fire_shards example.txt forest_fire 10 shards.out --seed 7 --shards 3
+cmp expected.txt shards.out
+
+cd ../../
+
+cd tests/circuit/
+rm -rf ./*.out
+pwd
+$DIR/bin/emergent ./circuit.emg
+$CLANG ./circuit.cpp -pthread -o circuit
+./circuit example.txt circuit 30 example.out
+cmp expected.txt example.out
 
 echo "***** TESTS PASSED *****"